@@ -0,0 +1,262 @@
+#include "AsyncIO.hpp"
+#include <cassert>
+#include <cerrno>
+#include <memory>
+#include <unistd.h>
+
+#ifdef VOXEL_IO_URING
+//==============================================================================
+constexpr unsigned AsyncIO::QUEUE_DEPTH;
+#endif
+
+//==============================================================================
+AsyncIO::AsyncIO(const int thread_count)
+{
+    assert(thread_count > 0 && "Need at least one IO thread.");
+
+#ifdef VOXEL_IO_URING
+    m_ring_ok = io_uring_queue_init(QUEUE_DEPTH, &m_ring, 0) == 0;
+
+    if (m_ring_ok)
+        m_reaper = std::thread{ &AsyncIO::reap, this };
+#endif
+
+    for (int i = 0; i < thread_count; ++i)
+        m_threads.emplace_back(&AsyncIO::worker, this);
+}
+
+//==============================================================================
+AsyncIO::~AsyncIO()
+{
+    drain();
+
+    {
+        std::unique_lock<std::mutex> lock{ m_jobs_lock };
+        m_quit = true;
+    }
+    m_jobs_condition.notify_all();
+
+    for (auto & thread : m_threads)
+        thread.join();
+
+#ifdef VOXEL_IO_URING
+    if (m_ring_ok)
+    {
+        // request without user data tells the reaper to exit
+        {
+            std::unique_lock<std::mutex> lock{ m_submit_lock };
+            auto * sqe = io_uring_get_sqe(&m_ring);
+            io_uring_prep_nop(sqe);
+            io_uring_sqe_set_data(sqe, nullptr);
+            io_uring_submit(&m_ring);
+        }
+
+        m_reaper.join();
+        io_uring_queue_exit(&m_ring);
+    }
+#endif
+}
+
+//==============================================================================
+bool AsyncIO::usesRing() const
+{
+#ifdef VOXEL_IO_URING
+    return m_ring_ok;
+#else
+    return false;
+#endif
+}
+
+//==============================================================================
+void AsyncIO::read(const int file, void * buffer, const std::size_t size, const off_t offset, Callback done)
+{
+    submit({ Type::READ, file, static_cast<char *>(buffer), size, offset, std::move(done) });
+}
+
+//==============================================================================
+void AsyncIO::write(const int file, const void * buffer, const std::size_t size, const off_t offset, Callback done)
+{
+    submit({ Type::WRITE, file, const_cast<char *>(static_cast<const char *>(buffer)), size, offset, std::move(done) });
+}
+
+//==============================================================================
+void AsyncIO::sync(const int file, Callback done)
+{
+    submit({ Type::SYNC, file, nullptr, 0, 0, std::move(done) });
+}
+
+//==============================================================================
+void AsyncIO::run(std::function<void()> job)
+{
+    ++m_pending;
+    enqueue([this, job] { job(); finished(); });
+}
+
+//==============================================================================
+void AsyncIO::submit(Request request)
+{
+    ++m_pending;
+
+#ifdef VOXEL_IO_URING
+    if (m_ring_ok)
+    {
+        submitToRing(new Request{ std::move(request) });
+        return;
+    }
+#endif
+
+    // std::function must be copyable, so the request can't be moved in
+    auto shared = std::make_shared<Request>(std::move(request));
+
+    enqueue([this, shared]
+    {
+        const auto result = execute(*shared);
+        if (shared->done) shared->done(result);
+        finished();
+    });
+}
+
+//==============================================================================
+ssize_t AsyncIO::execute(const Request & request)
+{
+    if (request.type == Type::SYNC)
+        return ::fdatasync(request.file) == 0 ? 0 : -errno;
+
+    std::size_t done = 0;
+
+    // short reads / writes are continued, end of file stops reading
+    while (done < request.size)
+    {
+        const auto result = request.type == Type::READ ?
+            ::pread(request.file, request.buffer + done, request.size - done, request.offset + static_cast<off_t>(done)) :
+            ::pwrite(request.file, request.buffer + done, request.size - done, request.offset + static_cast<off_t>(done));
+
+        if (result < 0)
+        {
+            if (errno == EINTR) continue;
+            return -errno;
+        }
+
+        if (result == 0)
+            break;
+
+        done += static_cast<std::size_t>(result);
+    }
+
+    return static_cast<ssize_t>(done);
+}
+
+//==============================================================================
+void AsyncIO::enqueue(std::function<void()> job)
+{
+    {
+        std::unique_lock<std::mutex> lock{ m_jobs_lock };
+        m_jobs.push_back(std::move(job));
+    }
+    m_jobs_condition.notify_one();
+}
+
+//==============================================================================
+void AsyncIO::worker()
+{
+    while (true)
+    {
+        std::function<void()> job;
+
+        {
+            std::unique_lock<std::mutex> lock{ m_jobs_lock };
+            m_jobs_condition.wait(lock, [this] { return m_quit || !m_jobs.empty(); });
+
+            if (m_jobs.empty())
+                return; // quit and nothing left
+
+            job = std::move(m_jobs.front());
+            m_jobs.pop_front();
+        }
+
+        job();
+    }
+}
+
+//==============================================================================
+void AsyncIO::finished()
+{
+    if (--m_pending == 0)
+    {
+        std::unique_lock<std::mutex> lock{ m_drain_lock };
+        m_drain_condition.notify_all();
+    }
+}
+
+//==============================================================================
+void AsyncIO::drain()
+{
+    std::unique_lock<std::mutex> lock{ m_drain_lock };
+    m_drain_condition.wait(lock, [this] { return m_pending.load() == 0; });
+}
+
+#ifdef VOXEL_IO_URING
+//==============================================================================
+void AsyncIO::submitToRing(Request * request)
+{
+    std::unique_lock<std::mutex> lock{ m_submit_lock };
+
+    auto * sqe = io_uring_get_sqe(&m_ring);
+
+    // submission queue full, push what we have to the kernel and try again
+    while (sqe == nullptr)
+    {
+        io_uring_submit(&m_ring);
+        std::this_thread::yield();
+        sqe = io_uring_get_sqe(&m_ring);
+    }
+
+    switch (request->type)
+    {
+        case Type::READ: io_uring_prep_read(sqe, request->file, request->buffer, static_cast<unsigned>(request->size), static_cast<__u64>(request->offset)); break;
+        case Type::WRITE: io_uring_prep_write(sqe, request->file, request->buffer, static_cast<unsigned>(request->size), static_cast<__u64>(request->offset)); break;
+        case Type::SYNC: io_uring_prep_fsync(sqe, request->file, IORING_FSYNC_DATASYNC); break;
+    }
+
+    io_uring_sqe_set_data(sqe, request);
+    io_uring_submit(&m_ring);
+}
+
+//==============================================================================
+void AsyncIO::reap()
+{
+    while (true)
+    {
+        io_uring_cqe * cqe = nullptr;
+
+        if (io_uring_wait_cqe(&m_ring, &cqe) != 0)
+            continue;
+
+        auto * request = static_cast<Request *>(io_uring_cqe_get_data(cqe));
+        const auto result = static_cast<ssize_t>(cqe->res);
+        io_uring_cqe_seen(&m_ring, cqe);
+
+        if (request == nullptr)
+            return;
+
+        // short transfers are rare, finish them synchronously
+        if (result >= 0 && request->type != Type::SYNC && static_cast<std::size_t>(result) < request->size)
+        {
+            auto rest = *request;
+            rest.buffer += result;
+            rest.size -= static_cast<std::size_t>(result);
+            rest.offset += static_cast<off_t>(result);
+
+            const auto rest_result = execute(rest);
+            if (request->done) request->done(rest_result < 0 ? rest_result : result + rest_result);
+        }
+        else if (request->done)
+        {
+            request->done(result);
+        }
+
+        delete request;
+        finished();
+    }
+}
+#endif
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <sys/types.h>
+
+#ifdef VOXEL_IO_URING
+#include <liburing.h>
+#endif
+
+// Asynchronous file IO.
+// With VOXEL_IO_URING, reads, writes and syncs are submitted to io_uring and
+// completed by a reaper thread. Otherwise (or if io_uring is not available at
+// runtime) they are executed with pread/pwrite/fdatasync on a thread pool.
+// run() always executes on the thread pool, it is meant for IO related CPU work.
+// Callbacks are executed on an IO thread and receive the result of the
+// operation (bytes transferred or -errno). All functions are thread safe.
+
+//==============================================================================
+class AsyncIO
+{
+public:
+    using Callback = std::function<void(const ssize_t result)>;
+
+    AsyncIO(const int thread_count);
+    ~AsyncIO(); // finishes all pending operations
+
+    AsyncIO(const AsyncIO &) = delete;
+    AsyncIO & operator = (const AsyncIO &) = delete;
+
+    void read(const int file, void * buffer, const std::size_t size, const off_t offset, Callback done);
+    void write(const int file, const void * buffer, const std::size_t size, const off_t offset, Callback done);
+    void sync(const int file, Callback done);
+    void run(std::function<void()> job);
+
+    void drain(); // blocks until nothing is pending
+    int pending() const { return m_pending.load(); }
+    bool usesRing() const;
+
+private:
+    enum class Type { READ, WRITE, SYNC };
+    struct Request { Type type; int file; char * buffer; std::size_t size; off_t offset; Callback done; };
+
+    std::vector<std::thread> m_threads;
+    std::deque<std::function<void()>> m_jobs;
+    std::mutex m_jobs_lock;
+    std::condition_variable m_jobs_condition;
+    bool m_quit{ false };
+
+    std::atomic_int m_pending{ 0 };
+    std::mutex m_drain_lock;
+    std::condition_variable m_drain_condition;
+
+#ifdef VOXEL_IO_URING
+    static constexpr unsigned QUEUE_DEPTH{ 256 };
+
+    io_uring m_ring;
+    bool m_ring_ok{ false };
+    std::mutex m_submit_lock;
+    std::thread m_reaper;
+
+    void submitToRing(Request * request);
+    void reap();
+#endif
+
+    void submit(Request request);
+    void enqueue(std::function<void()> job);
+    void finished();
+    void worker();
+    static ssize_t execute(const Request & request);
+
+};
@@ -0,0 +1,195 @@
+#include "ChunkCache.hpp"
+#include <cassert>
+#include <utility>
+
+//==============================================================================
+constexpr int ChunkCache::SHARD_COUNT;
+
+//==============================================================================
+ChunkCache::ChunkCache(const int chunk_size, const int capacity) :
+    m_shards{ std::make_unique<Shard[]>(SHARD_COUNT) }
+{
+    assert(chunk_size > 0 && capacity >= SHARD_COUNT && "Cache too small.");
+
+    const auto per_shard = (capacity + SHARD_COUNT - 1) / SHARD_COUNT;
+
+    for (int s = 0; s < SHARD_COUNT; ++s)
+    {
+        auto & shard = m_shards[s];
+
+        shard.chunk_size = chunk_size;
+        shard.blocks = std::make_unique<Block[]>(static_cast<std::size_t>(chunk_size) * per_shard);
+        shard.entries.resize(static_cast<std::size_t>(per_shard));
+        shard.index.reserve(static_cast<std::size_t>(per_shard));
+
+        // all entries start unused at the end of the LRU list
+        for (int i = 0; i < per_shard; ++i)
+        {
+            shard.entries[i] = { 0, 0, false, false, -1, -1 };
+            shard.pushFront(i);
+        }
+    }
+}
+
+//==============================================================================
+uint64_t ChunkCache::keyOf(const i32Vec3 chunk_position)
+{
+    // 21 bits per axis is more than the world will ever need
+    const auto bits = [](const int32_t v) { return static_cast<uint64_t>(static_cast<uint32_t>(v) & 0x1FFFFF); };
+    return bits(chunk_position[0]) | bits(chunk_position[1]) << 21 | bits(chunk_position[2]) << 42;
+}
+
+//==============================================================================
+ChunkCache::Handle ChunkCache::get(const i32Vec3 chunk_position, const Load & load)
+{
+    const auto key = keyOf(chunk_position);
+    auto & shard = m_shards[(key * 0x9E3779B97F4A7C15ull) >> 60];
+
+    std::unique_lock<std::mutex> lock{ shard.lock };
+
+    while (true)
+    {
+        const auto found = shard.index.find(key);
+
+        if (found == shard.index.end())
+            break;
+
+        auto & entry = shard.entries[found->second];
+
+        // somebody else is decoding it right now
+        if (entry.loading)
+        {
+            shard.changed.wait(lock);
+            continue;
+        }
+
+        ++entry.references;
+        shard.unlink(found->second);
+        shard.pushFront(found->second);
+        ++m_hits;
+
+        return { &shard, found->second, shard.blocks.get() + static_cast<std::size_t>(found->second) * shard.chunk_size };
+    }
+
+    ++m_misses;
+
+    int index = shard.evict();
+
+    // every chunk is in use, wait until one is released
+    while (index == -1)
+    {
+        shard.changed.wait(lock);
+        index = shard.evict();
+    }
+
+    auto & entry = shard.entries[index];
+    entry.key = key;
+    entry.references = 1;
+    entry.loading = true;
+    entry.valid = true;
+    shard.index[key] = index;
+    shard.pushFront(index);
+
+    auto * blocks = shard.blocks.get() + static_cast<std::size_t>(index) * shard.chunk_size;
+
+    lock.unlock();
+    load(blocks);
+    lock.lock();
+
+    entry.loading = false;
+    shard.changed.notify_all();
+
+    return { &shard, index, blocks };
+}
+
+//==============================================================================
+void ChunkCache::invalidate(const i32Vec3 chunk_position)
+{
+    const auto key = keyOf(chunk_position);
+    auto & shard = m_shards[(key * 0x9E3779B97F4A7C15ull) >> 60];
+
+    std::unique_lock<std::mutex> lock{ shard.lock };
+
+    const auto found = shard.index.find(key);
+
+    if (found == shard.index.end())
+        return;
+
+    // the entry is reused once it is no longer referenced
+    shard.entries[found->second].valid = false;
+    shard.index.erase(found);
+}
+
+//==============================================================================
+void ChunkCache::Shard::unlink(const int entry)
+{
+    auto & e = entries[entry];
+
+    if (e.previous != -1) entries[e.previous].next = e.next; else head = e.next;
+    if (e.next != -1) entries[e.next].previous = e.previous; else tail = e.previous;
+
+    e.previous = e.next = -1;
+}
+
+//==============================================================================
+void ChunkCache::Shard::pushFront(const int entry)
+{
+    auto & e = entries[entry];
+
+    e.previous = -1;
+    e.next = head;
+
+    if (head != -1) entries[head].previous = entry; else tail = entry;
+    head = entry;
+}
+
+//==============================================================================
+int ChunkCache::Shard::evict()
+{
+    for (int i = tail; i != -1; i = entries[i].previous)
+    {
+        auto & entry = entries[i];
+
+        if (entry.references != 0)
+            continue;
+
+        if (entry.valid)
+            index.erase(entry.key);
+
+        entry.valid = false;
+        unlink(i);
+
+        return i;
+    }
+
+    return -1;
+}
+
+//==============================================================================
+void ChunkCache::Handle::release()
+{
+    if (m_shard == nullptr)
+        return;
+
+    {
+        std::unique_lock<std::mutex> lock{ m_shard->lock };
+        auto & entry = m_shard->entries[m_entry];
+
+        assert(entry.references > 0 && "Released more often than acquired.");
+
+        if (--entry.references == 0)
+            m_shard->changed.notify_all();
+    }
+
+    m_shard = nullptr;
+    m_entry = -1;
+    m_blocks = nullptr;
+}
+
+//==============================================================================
+void ChunkCache::Handle::swap(Handle & other)
+{
+    std::swap(m_shard, other.m_shard);
+    std::swap(m_entry, other.m_entry);
+    std::swap(m_blocks, other.m_blocks);
+}
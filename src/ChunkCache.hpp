@@ -0,0 +1,95 @@
+#pragma once
+
+#include "Algebra.hpp"
+#include "Block.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Size bounded cache of decoded chunks, shared by all loader threads.
+// get() returns a handle that keeps the chunk from being evicted until it is destroyed.
+// On a miss the chunk is decoded by the caller's load function outside of any lock;
+// other threads asking for the same chunk meanwhile wait for it instead of decoding it again.
+// Least recently used unreferenced chunks are evicted first. Thread safe.
+
+//==============================================================================
+class ChunkCache
+{
+private:
+    struct Shard;
+
+public:
+    using Load = std::function<void(Block * destination)>;
+
+    //==============================================================================
+    class Handle
+    {
+    public:
+        Handle() {}
+        Handle(Handle && other) { swap(other); }
+        Handle & operator = (Handle && other) { release(); swap(other); return *this; }
+        ~Handle() { release(); }
+
+        Handle(const Handle &) = delete;
+        Handle & operator = (const Handle &) = delete;
+
+        const Block * blocks() const { return m_blocks; }
+        void release();
+
+    private:
+        friend class ChunkCache;
+        Handle(Shard * shard, const int entry, const Block * blocks) : m_shard{ shard }, m_entry{ entry }, m_blocks{ blocks } {}
+        void swap(Handle & other);
+
+        Shard * m_shard{ nullptr };
+        int m_entry{ -1 };
+        const Block * m_blocks{ nullptr };
+
+    };
+
+    ChunkCache(const int chunk_size, const int capacity); // sizes in blocks and in chunks
+
+    Handle get(const i32Vec3 chunk_position, const Load & load);
+    void invalidate(const i32Vec3 chunk_position); // next get() decodes again, current handles stay valid
+
+    long long hits() const { return m_hits.load(); }
+    long long misses() const { return m_misses.load(); }
+
+private:
+    static constexpr int SHARD_COUNT{ 16 };
+
+    struct Entry
+    {
+        uint64_t key;
+        int references;
+        bool loading, valid;
+        int previous, next; // LRU list, most recently used first
+    };
+
+    struct Shard
+    {
+        std::mutex lock;
+        std::condition_variable changed; // chunk loaded or reference released
+        std::unordered_map<uint64_t, int> index;
+        std::vector<Entry> entries;
+        std::unique_ptr<Block[]> blocks;
+        int chunk_size;
+        int head{ -1 }, tail{ -1 };
+
+        void unlink(const int entry);
+        void pushFront(const int entry);
+        int evict(); // -1 if everything is referenced
+    };
+
+    std::unique_ptr<Shard[]> m_shards;
+    std::atomic<long long> m_hits{ 0 };
+    std::atomic<long long> m_misses{ 0 };
+
+    static uint64_t keyOf(const i32Vec3 chunk_position);
+
+};
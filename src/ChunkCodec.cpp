@@ -0,0 +1,439 @@
+#include "ChunkCodec.hpp"
+#include <cassert>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <zlib.h>
+
+#ifdef VOXEL_LZ4
+#include <lz4.h>
+#endif
+
+#ifdef VOXEL_ZSTD
+#include <zstd.h>
+#include <zdict.h>
+#endif
+
+#ifdef VOXEL_ZSTD
+//==============================================================================
+namespace
+{
+    struct ZstdDeleter
+    {
+        void operator () (ZSTD_CCtx * context) const { ZSTD_freeCCtx(context); }
+        void operator () (ZSTD_DCtx * context) const { ZSTD_freeDCtx(context); }
+        void operator () (ZSTD_CDict * dictionary) const { ZSTD_freeCDict(dictionary); }
+        void operator () (ZSTD_DDict * dictionary) const { ZSTD_freeDDict(dictionary); }
+    };
+
+    constexpr int ZSTD_LEVEL{ 3 };
+
+    std::unique_ptr<ZSTD_CDict, ZstdDeleter> zstd_compress_dictionary;
+    std::unique_ptr<ZSTD_DDict, ZstdDeleter> zstd_decompress_dictionary;
+
+    // contexts are reused, creating them is expensive
+    ZSTD_CCtx * zstdCompressContext()
+    {
+        thread_local std::unique_ptr<ZSTD_CCtx, ZstdDeleter> context{ ZSTD_createCCtx() };
+        return context.get();
+    }
+
+    ZSTD_DCtx * zstdDecompressContext()
+    {
+        thread_local std::unique_ptr<ZSTD_DCtx, ZstdDeleter> context{ ZSTD_createDCtx() };
+        return context.get();
+    }
+}
+#endif
+
+//==============================================================================
+bool ChunkCodec::available(const Codec codec)
+{
+    switch (codec)
+    {
+        case Codec::ZLIB: case Codec::NONE: case Codec::RLE: case Codec::PALETTE: return true;
+#ifdef VOXEL_LZ4
+        case Codec::LZ4: return true;
+#endif
+#ifdef VOXEL_ZSTD
+        case Codec::ZSTD: return true;
+#endif
+        default: return false;
+    }
+}
+
+//==============================================================================
+const char * ChunkCodec::name(const Codec codec)
+{
+    switch (codec)
+    {
+        case Codec::ZLIB: return "zlib";
+        case Codec::NONE: return "none";
+        case Codec::RLE: return "rle";
+        case Codec::LZ4: return "lz4";
+        case Codec::ZSTD: return "zstd";
+        case Codec::PALETTE: return "palette";
+        default: return "invalid";
+    }
+}
+
+//==============================================================================
+std::size_t ChunkCodec::bound(const Codec codec, const std::size_t size)
+{
+    assert(available(codec) && "Codec not available.");
+
+    switch (codec)
+    {
+        case Codec::ZLIB: return compressBound(static_cast<uLong>(size));
+        case Codec::NONE: return size;
+        case Codec::RLE: return size * 2; // one (count, value) pair per block at worst
+        case Codec::PALETTE: return 2 + 256 + size; // 8 bit indices at worst
+#ifdef VOXEL_LZ4
+        case Codec::LZ4: return static_cast<std::size_t>(LZ4_compressBound(static_cast<int>(size)));
+#endif
+#ifdef VOXEL_ZSTD
+        case Codec::ZSTD: return ZSTD_compressBound(size);
+#endif
+        default: return 0;
+    }
+}
+
+//==============================================================================
+std::size_t ChunkCodec::compress(const Codec codec, char * destination, const std::size_t capacity, const char * source, const std::size_t size, const i32Vec3 chunk_sizes)
+{
+    assert(available(codec) && "Codec not available.");
+
+    switch (codec)
+    {
+        case Codec::ZLIB:
+        {
+            uLongf destination_length = static_cast<uLongf>(capacity);
+            const auto result = compress2(reinterpret_cast<Bytef *>(destination), &destination_length, reinterpret_cast<const Bytef *>(source), static_cast<uLong>(size), Z_BEST_SPEED);
+            return result == Z_OK ? static_cast<std::size_t>(destination_length) : 0;
+        }
+        case Codec::NONE:
+        {
+            if (capacity < size) return 0;
+            std::memcpy(destination, source, size);
+            return size;
+        }
+        case Codec::RLE:
+            return compressRLE(destination, capacity, source, size, chunk_sizes);
+        case Codec::PALETTE:
+            return compressPalette(destination, capacity, source, size);
+#ifdef VOXEL_LZ4
+        case Codec::LZ4:
+        {
+            const auto result = LZ4_compress_default(source, destination, static_cast<int>(size), static_cast<int>(capacity));
+            return result > 0 ? static_cast<std::size_t>(result) : 0;
+        }
+#endif
+#ifdef VOXEL_ZSTD
+        case Codec::ZSTD:
+        {
+            const auto result = zstd_compress_dictionary ?
+                ZSTD_compress_usingCDict(zstdCompressContext(), destination, capacity, source, size, zstd_compress_dictionary.get()) :
+                ZSTD_compressCCtx(zstdCompressContext(), destination, capacity, source, size, ZSTD_LEVEL);
+            return ZSTD_isError(result) ? 0 : result;
+        }
+#endif
+        default:
+            return 0;
+    }
+}
+
+//==============================================================================
+bool ChunkCodec::decompress(const Codec codec, char * destination, const std::size_t size, const char * source, const std::size_t source_size, const i32Vec3 chunk_sizes)
+{
+    switch (codec)
+    {
+        case Codec::ZLIB:
+        {
+            uLongf destination_length = static_cast<uLongf>(size);
+            const auto result = uncompress(reinterpret_cast<Bytef *>(destination), &destination_length, reinterpret_cast<const Bytef *>(source), static_cast<uLong>(source_size));
+            return result == Z_OK && destination_length == size;
+        }
+        case Codec::NONE:
+        {
+            if (source_size != size) return false;
+            std::memcpy(destination, source, size);
+            return true;
+        }
+        case Codec::RLE:
+            return decompressRLE(destination, size, source, source_size, chunk_sizes);
+        case Codec::PALETTE:
+            return decompressPalette(destination, size, source, source_size);
+#ifdef VOXEL_LZ4
+        case Codec::LZ4:
+            return LZ4_decompress_safe(source, destination, static_cast<int>(source_size), static_cast<int>(size)) == static_cast<int>(size);
+#endif
+#ifdef VOXEL_ZSTD
+        case Codec::ZSTD:
+        {
+            // without a dictionary loaded, zstd fails on chunks that need one
+            const auto result = zstd_decompress_dictionary ?
+                ZSTD_decompress_usingDDict(zstdDecompressContext(), destination, size, source, source_size, zstd_decompress_dictionary.get()) :
+                ZSTD_decompressDCtx(zstdDecompressContext(), destination, size, source, source_size);
+            return !ZSTD_isError(result) && result == size;
+        }
+#endif
+        default:
+            return false;
+    }
+}
+
+//==============================================================================
+bool ChunkCodec::uniform(const Codec codec, const char * source, const std::size_t source_size, char & value)
+{
+    // only palette chunks know it without decoding
+    if (codec != Codec::PALETTE || source_size != 1)
+        return false;
+
+    value = source[0];
+
+    return true;
+}
+
+//==============================================================================
+std::size_t ChunkCodec::compressRLE(char * destination, const std::size_t capacity, const char * source, const std::size_t size, const i32Vec3 chunk_sizes)
+{
+    assert(static_cast<std::size_t>(product(chunk_sizes)) == size && "Chunk size mismatch.");
+
+    // (count, value) pairs, count 0 means 256. runs continue from one column to the next
+    std::size_t written = 0;
+    int run = 0;
+    char value = source[0];
+
+    auto flush = [&]
+    {
+        if (written + 2 > capacity) return false;
+        destination[written++] = static_cast<char>(static_cast<unsigned char>(run));
+        destination[written++] = value;
+        run = 0;
+        return true;
+    };
+
+    const auto stride_y = chunk_sizes[0];
+    const auto stride_z = chunk_sizes[0] * chunk_sizes[1];
+
+    for (int z = 0; z < chunk_sizes[2]; ++z)
+        for (int x = 0; x < chunk_sizes[0]; ++x)
+        {
+            const char * column = source + z * stride_z + x;
+
+            for (int y = 0; y < chunk_sizes[1]; ++y)
+            {
+                const auto current = column[y * stride_y];
+
+                if (current != value || run == 256)
+                {
+                    if (!flush()) return 0;
+                    value = current;
+                }
+
+                ++run;
+            }
+        }
+
+    if (!flush()) return 0;
+
+    return written;
+}
+
+//==============================================================================
+bool ChunkCodec::decompressRLE(char * destination, const std::size_t size, const char * source, const std::size_t source_size, const i32Vec3 chunk_sizes)
+{
+    assert(static_cast<std::size_t>(product(chunk_sizes)) == size && "Chunk size mismatch.");
+
+    if (source_size % 2 != 0)
+        return false;
+
+    const auto stride_y = chunk_sizes[0];
+    const auto stride_z = chunk_sizes[0] * chunk_sizes[1];
+
+    const auto * pair = source;
+    const auto * const end = source + source_size;
+    int left = 0;
+    char value = 0;
+
+    for (int z = 0; z < chunk_sizes[2]; ++z)
+        for (int x = 0; x < chunk_sizes[0]; ++x)
+        {
+            char * column = destination + z * stride_z + x;
+
+            for (int y = 0; y < chunk_sizes[1]; ++y)
+            {
+                if (left == 0)
+                {
+                    if (pair == end) return false;
+
+                    left = static_cast<unsigned char>(pair[0]);
+                    if (left == 0) left = 256;
+                    value = pair[1];
+                    pair += 2;
+                }
+
+                column[y * stride_y] = value;
+                --left;
+            }
+        }
+
+    return left == 0 && pair == end;
+}
+
+//==============================================================================
+std::size_t ChunkCodec::compressPalette(char * destination, const std::size_t capacity, const char * source, const std::size_t size)
+{
+    // uniform: [value]
+    // otherwise: [bits][palette size - 1][palette][indices, packed starting at the low bits]
+    int index_of[256];
+    for (auto & i : index_of) i = -1;
+
+    unsigned char palette[256];
+    int palette_size = 0;
+
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        const auto value = static_cast<unsigned char>(source[i]);
+
+        if (index_of[value] == -1)
+        {
+            index_of[value] = palette_size;
+            palette[palette_size++] = value;
+        }
+    }
+
+    if (palette_size == 1)
+    {
+        if (capacity < 1) return 0;
+        destination[0] = source[0];
+        return 1;
+    }
+
+    int bits = 1;
+    while ((1 << bits) < palette_size) bits *= 2;
+
+    const auto per_byte = 8 / bits;
+    const auto packed_size = (size + per_byte - 1) / per_byte;
+    const auto total = 2 + static_cast<std::size_t>(palette_size) + packed_size;
+
+    if (total > capacity)
+        return 0;
+
+    destination[0] = static_cast<char>(bits);
+    destination[1] = static_cast<char>(palette_size - 1);
+    std::memcpy(destination + 2, palette, static_cast<std::size_t>(palette_size));
+
+    auto * packed = reinterpret_cast<unsigned char *>(destination + 2 + palette_size);
+    std::memset(packed, 0, packed_size);
+
+    for (std::size_t i = 0; i < size; ++i)
+    {
+        const auto index = static_cast<unsigned>(index_of[static_cast<unsigned char>(source[i])]);
+        packed[i / per_byte] |= static_cast<unsigned char>(index << ((i % per_byte) * bits));
+    }
+
+    return total;
+}
+
+//==============================================================================
+bool ChunkCodec::decompressPalette(char * destination, const std::size_t size, const char * source, const std::size_t source_size)
+{
+    if (source_size == 1)
+    {
+        std::memset(destination, source[0], size);
+        return true;
+    }
+
+    if (source_size < 2)
+        return false;
+
+    const int bits = static_cast<unsigned char>(source[0]);
+    const int palette_size = static_cast<unsigned char>(source[1]) + 1;
+
+    if (bits != 1 && bits != 2 && bits != 4 && bits != 8)
+        return false;
+
+    const auto per_byte = 8 / bits;
+    const auto packed_size = (size + per_byte - 1) / per_byte;
+
+    if (source_size != 2 + static_cast<std::size_t>(palette_size) + packed_size)
+        return false;
+
+    // unused palette entries decode to the first one, so broken indices can't read out of bounds
+    char palette[256];
+    for (int i = 0; i < 256; ++i)
+        palette[i] = source[2 + (i < palette_size ? i : 0)];
+
+    const auto * packed = reinterpret_cast<const unsigned char *>(source + 2 + palette_size);
+    const unsigned mask = (1u << bits) - 1;
+
+    for (std::size_t i = 0; i < size; ++packed)
+    {
+        unsigned byte = *packed;
+
+        for (int k = 0; k < per_byte && i < size; ++k, ++i)
+        {
+            destination[i] = palette[byte & mask];
+            byte >>= bits;
+        }
+    }
+
+    return true;
+}
+
+//==============================================================================
+bool ChunkCodec::loadZstdDictionary(const std::string & file_name)
+{
+    std::ifstream file{ file_name, std::ifstream::binary | std::ifstream::ate };
+
+    if (!file.good())
+        return false;
+
+    const auto size = static_cast<std::size_t>(file.tellg());
+    std::vector<char> data(size);
+
+    file.seekg(0);
+    file.read(data.data(), static_cast<std::streamsize>(size));
+
+    if (!file.good())
+        return false;
+
+    setZstdDictionary(data.data(), data.size());
+
+    return true;
+}
+
+//==============================================================================
+void ChunkCodec::setZstdDictionary(const char * data, const std::size_t size)
+{
+#ifdef VOXEL_ZSTD
+    zstd_compress_dictionary.reset(ZSTD_createCDict(data, size, ZSTD_LEVEL));
+    zstd_decompress_dictionary.reset(ZSTD_createDDict(data, size));
+#else
+    (void)data;
+    (void)size;
+#endif
+}
+
+//==============================================================================
+std::vector<char> ChunkCodec::trainZstdDictionary(const std::vector<char> & samples, const std::vector<std::size_t> & sample_sizes, const std::size_t capacity)
+{
+#ifdef VOXEL_ZSTD
+    std::vector<char> dictionary(capacity);
+
+    const auto result = ZDICT_trainFromBuffer(dictionary.data(), capacity, samples.data(), sample_sizes.data(), static_cast<unsigned>(sample_sizes.size()));
+
+    if (ZDICT_isError(result))
+        return {};
+
+    dictionary.resize(result);
+
+    return dictionary;
+#else
+    (void)samples;
+    (void)sample_sizes;
+    (void)capacity;
+    return {};
+#endif
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "Algebra.hpp"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Values are stored in region files, only append new codecs.
+// ZLIB must stay 0, region files written before codecs existed contain zlib only.
+enum class Codec : unsigned char { ZLIB = 0, NONE = 1, RLE = 2, LZ4 = 3, ZSTD = 4, PALETTE = 5, last };
+
+// Chunk compression.
+// ZLIB, NONE and RLE are always available. LZ4 and ZSTD only if the library
+// was found at build time (VOXEL_LZ4, VOXEL_ZSTD).
+// RLE is tuned for chunks of blocks: it runs along the y axis (columns), which
+// turns terrain into a few runs per column.
+// PALETTE stores a uniform chunk as its single value, other chunks as a palette
+// and 1, 2, 4 or 8 bit indices. It is meant for chunks with few block types:
+// uniform chunks can be recognized without decoding and decoding is a plain unpack.
+// All functions are thread safe, except setting the Zstd dictionary.
+
+//==============================================================================
+class ChunkCodec
+{
+public:
+    static bool available(const Codec codec);
+    static const char * name(const Codec codec);
+
+    // chunk_sizes: extent of the chunk in blocks (only used by RLE), data is in position_to_index() order
+    static std::size_t bound(const Codec codec, const std::size_t size);
+    static std::size_t compress(const Codec codec, char * destination, const std::size_t capacity, const char * source, const std::size_t size, const i32Vec3 chunk_sizes); // returns 0 on failure
+    static bool decompress(const Codec codec, char * destination, const std::size_t size, const char * source, const std::size_t source_size, const i32Vec3 chunk_sizes);
+    static bool uniform(const Codec codec, const char * source, const std::size_t source_size, char & value); // true if every byte is value, without decoding
+
+    // Zstd dictionary, set before using ZSTD from any thread. Chunks compressed with a
+    // dictionary can only be decompressed with the same one (checked by zstd)
+    static bool loadZstdDictionary(const std::string & file_name);
+    static void setZstdDictionary(const char * data, const std::size_t size);
+    static std::vector<char> trainZstdDictionary(const std::vector<char> & samples, const std::vector<std::size_t> & sample_sizes, const std::size_t capacity);
+
+private:
+    static std::size_t compressRLE(char * destination, const std::size_t capacity, const char * source, const std::size_t size, const i32Vec3 chunk_sizes);
+    static bool decompressRLE(char * destination, const std::size_t size, const char * source, const std::size_t source_size, const i32Vec3 chunk_sizes);
+    static std::size_t compressPalette(char * destination, const std::size_t capacity, const char * source, const std::size_t size);
+    static bool decompressPalette(char * destination, const std::size_t size, const char * source, const std::size_t source_size);
+
+};
@@ -0,0 +1,23 @@
+#include "ChunkSummary.hpp"
+
+//==============================================================================
+constexpr unsigned char ChunkSummary::ALL_EMPTY;
+constexpr unsigned char ChunkSummary::ALL_SOLID;
+
+//==============================================================================
+ChunkSummary ChunkSummary::of(const Block * const blocks, const i32Vec3 sizes)
+{
+    const auto size = product(sizes);
+
+    int empty = 0;
+    for (int i = 0; i < size; ++i)
+        empty += blocks[i].isEmpty();
+
+    if (empty == size)
+        return ChunkSummary{ ALL_EMPTY };
+
+    if (empty == 0)
+        return ChunkSummary{ ALL_SOLID };
+
+    return ChunkSummary{};
+}
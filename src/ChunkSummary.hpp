@@ -0,0 +1,30 @@
+#pragma once
+
+#include "Algebra.hpp"
+#include "Block.hpp"
+
+// What is known about a chunk without decoding it, computed when the chunk is stored.
+// A default constructed summary knows nothing (no flag set), which is always correct.
+
+//==============================================================================
+class ChunkSummary
+{
+public:
+    ChunkSummary() : m_bits{ 0 } {}
+    explicit ChunkSummary(const unsigned char bits) : m_bits{ bits } {}
+
+    static ChunkSummary of(const Block * const blocks, const i32Vec3 sizes); // blocks in position_to_index() order
+
+    bool allEmpty() const { return (m_bits & ALL_EMPTY) != 0; }
+    bool allSolid() const { return (m_bits & ALL_SOLID) != 0; }
+    unsigned char bits() const { return m_bits; }
+
+private:
+    static constexpr unsigned char ALL_EMPTY{ 1 << 0 };
+    static constexpr unsigned char ALL_SOLID{ 1 << 1 };
+
+    unsigned char m_bits; // the other bits are reserved and ignored
+
+};
+
+static_assert(sizeof(ChunkSummary) == 1, "Stored in region files.");
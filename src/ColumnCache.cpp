@@ -0,0 +1,105 @@
+#include "ColumnCache.hpp"
+#include <cassert>
+
+//==============================================================================
+constexpr int ColumnCache::SHARD_COUNT;
+
+//==============================================================================
+ColumnCache::ColumnCache(const int capacity) :
+    m_shards{ std::make_unique<Shard[]>(SHARD_COUNT) }
+{
+    assert(capacity >= SHARD_COUNT && "Cache too small.");
+
+    const auto per_shard = (capacity + SHARD_COUNT - 1) / SHARD_COUNT;
+
+    for (int s = 0; s < SHARD_COUNT; ++s)
+    {
+        auto & shard = m_shards[s];
+
+        shard.columns = std::make_unique<Terrain::Columns[]>(static_cast<std::size_t>(per_shard));
+        shard.entries.resize(static_cast<std::size_t>(per_shard));
+        shard.index.reserve(static_cast<std::size_t>(per_shard));
+
+        // all entries start unused at the end of the LRU list
+        for (int i = 0; i < per_shard; ++i)
+        {
+            shard.entries[i] = { 0, false, -1, -1 };
+            shard.pushFront(i);
+        }
+    }
+}
+
+//==============================================================================
+uint64_t ColumnCache::keyOf(const i32Vec2 column_position)
+{
+    return static_cast<uint64_t>(static_cast<uint32_t>(column_position[0])) | static_cast<uint64_t>(static_cast<uint32_t>(column_position[1])) << 32;
+}
+
+//==============================================================================
+void ColumnCache::get(const i32Vec2 column_position, Terrain::Columns & destination, const Compute & compute)
+{
+    const auto key = keyOf(column_position);
+    auto & shard = m_shards[(key * 0x9E3779B97F4A7C15ull) >> 60];
+
+    {
+        std::unique_lock<std::mutex> lock{ shard.lock };
+        const auto found = shard.index.find(key);
+
+        if (found != shard.index.end())
+        {
+            shard.unlink(found->second);
+            shard.pushFront(found->second);
+            destination = shard.columns[found->second];
+            ++m_hits;
+            return;
+        }
+    }
+
+    ++m_misses;
+
+    // noise is the expensive part, nobody waits for it
+    compute(destination);
+
+    std::unique_lock<std::mutex> lock{ shard.lock };
+
+    // another thread computed it meanwhile
+    if (shard.index.find(key) != shard.index.end())
+        return;
+
+    const auto index = shard.tail;
+    auto & entry = shard.entries[index];
+
+    if (entry.valid)
+        shard.index.erase(entry.key);
+
+    entry.key = key;
+    entry.valid = true;
+    shard.columns[index] = destination;
+    shard.index.emplace(key, index);
+
+    shard.unlink(index);
+    shard.pushFront(index);
+}
+
+//==============================================================================
+void ColumnCache::Shard::unlink(const int entry)
+{
+    auto & e = entries[entry];
+
+    if (e.previous != -1) entries[e.previous].next = e.next; else head = e.next;
+    if (e.next != -1) entries[e.next].previous = e.previous; else tail = e.previous;
+
+    e.previous = e.next = -1;
+}
+
+//==============================================================================
+void ColumnCache::Shard::pushFront(const int entry)
+{
+    auto & e = entries[entry];
+
+    e.previous = -1;
+    e.next = head;
+
+    if (head != -1) entries[head].previous = entry; else tail = entry;
+    head = entry;
+}
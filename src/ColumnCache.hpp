@@ -0,0 +1,61 @@
+#pragma once
+
+#include "Algebra.hpp"
+#include "Terrain.hpp"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Size bounded cache of Terrain::Columns per chunk column, shared by all loader threads.
+// Chunks stacked on top of each other need the same 2D noise, with the cache it is evaluated
+// once per column instead of once per chunk. get() copies the columns out; on a miss they are
+// computed by the caller's function outside of any lock. Two threads missing the same column at
+// once both compute it, which is harmless because the result is the same.
+// Least recently used columns are evicted first. Thread safe.
+
+//==============================================================================
+class ColumnCache
+{
+public:
+    using Compute = std::function<void(Terrain::Columns & destination)>;
+
+    ColumnCache(const int capacity); // in columns
+
+    void get(const i32Vec2 column_position, Terrain::Columns & destination, const Compute & compute);
+
+    long long hits() const { return m_hits.load(); }
+    long long misses() const { return m_misses.load(); }
+
+private:
+    static constexpr int SHARD_COUNT{ 16 };
+
+    struct Entry
+    {
+        uint64_t key;
+        bool valid;
+        int previous, next; // LRU list, most recently used first
+    };
+
+    struct Shard
+    {
+        std::mutex lock;
+        std::unordered_map<uint64_t, int> index;
+        std::vector<Entry> entries;
+        std::unique_ptr<Terrain::Columns[]> columns;
+        int head{ -1 }, tail{ -1 };
+
+        void unlink(const int entry);
+        void pushFront(const int entry);
+    };
+
+    std::unique_ptr<Shard[]> m_shards;
+    std::atomic<long long> m_hits{ 0 };
+    std::atomic<long long> m_misses{ 0 };
+
+    static uint64_t keyOf(const i32Vec2 column_position);
+
+};
@@ -0,0 +1,148 @@
+#pragma once
+
+#include "MemoryBlockUnit.hpp"
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <utility>
+
+// Thread safe variant of MemoryBlock: allocate() may be called from any number of threads at once.
+// Space is reserved with an atomic add on the current unit, only installing a new unit takes a lock.
+// Stored data is never moved. The tail of a unit that was too small for a request is wasted.
+// reset(), swap(), moving and destruction are not thread safe. reset() keeps the units for reuse.
+
+//==============================================================================
+template<std::size_t SIZE = MemoryBlockUnit<1337>::recommendSize(1024 * 1024 - PAGE_SIZE + 1)>
+class ConcurrentMemoryBlock
+{
+public:
+    ConcurrentMemoryBlock() {}
+
+    ConcurrentMemoryBlock(const ConcurrentMemoryBlock &) = delete;
+    ConcurrentMemoryBlock & operator = (const ConcurrentMemoryBlock &) = delete;
+
+    // stored data stays where it is, only the ownership moves
+    ConcurrentMemoryBlock(ConcurrentMemoryBlock && other) { swap(other); }
+    ConcurrentMemoryBlock & operator = (ConcurrentMemoryBlock && other)
+    {
+        release();
+        swap(other);
+        return *this;
+    }
+
+    ~ConcurrentMemoryBlock() { release(); }
+
+    char * allocate(const std::size_t size)
+    {
+        if (size > SIZE) throw 1;
+
+        while (true)
+        {
+            auto * unit = m_current.load(std::memory_order_acquire);
+
+            if (unit != nullptr)
+            {
+                const auto offset = unit->end.fetch_add(size, std::memory_order_relaxed);
+
+                if (offset + size <= SIZE)
+                {
+                    m_used.fetch_add(size, std::memory_order_relaxed);
+                    return unit->data + offset;
+                }
+
+                // only the first request that does not fit sees the real end of the unit
+                if (offset <= SIZE)
+                    m_wasted.fetch_add(SIZE - offset, std::memory_order_relaxed);
+            }
+
+            grow(unit);
+        }
+    }
+
+    // moves all units to the free list
+    void reset()
+    {
+        auto * unit = m_current.load();
+
+        while (unit != nullptr)
+        {
+            auto * next = unit->next;
+            unit->next = m_free;
+            m_free = unit;
+            unit = next;
+        }
+
+        m_current.store(nullptr);
+        m_used.store(0);
+        m_wasted.store(0);
+    }
+
+    void swap(ConcurrentMemoryBlock & other)
+    {
+        m_current.store(other.m_current.exchange(m_current.load()));
+        std::swap(m_free, other.m_free);
+        m_used.store(other.m_used.exchange(m_used.load()));
+        m_wasted.store(other.m_wasted.exchange(m_wasted.load()));
+        m_unit_count.store(other.m_unit_count.exchange(m_unit_count.load()));
+    }
+
+    std::size_t bytesUsed() const { return m_used.load(); }
+    std::size_t bytesWasted() const { return m_wasted.load(); }
+    std::size_t bytesReserved() const { return m_unit_count.load() * SIZE; } // including free units
+
+private:
+    struct Unit
+    {
+        std::atomic<std::size_t> end;
+        Unit * next;
+        char data[SIZE];
+    };
+
+    void grow(Unit * const full)
+    {
+        std::unique_lock<std::mutex> lock{ m_grow_lock };
+
+        // another thread was faster
+        if (m_current.load() != full)
+            return;
+
+        auto * unit = m_free;
+
+        if (unit != nullptr)
+        {
+            m_free = unit->next;
+        }
+        else
+        {
+            unit = new Unit;
+            ++m_unit_count;
+        }
+
+        unit->end.store(0, std::memory_order_relaxed);
+        unit->next = full;
+        m_current.store(unit, std::memory_order_release);
+    }
+
+    void release()
+    {
+        reset();
+
+        while (m_free != nullptr)
+        {
+            auto * next = m_free->next;
+            delete m_free;
+            m_free = next;
+        }
+
+        m_unit_count.store(0);
+    }
+
+    std::atomic<Unit *> m_current{ nullptr };
+    Unit * m_free{ nullptr };
+    std::mutex m_grow_lock;
+
+    std::atomic<std::size_t> m_used{ 0 };
+    std::atomic<std::size_t> m_wasted{ 0 };
+    std::atomic<std::size_t> m_unit_count{ 0 };
+
+};
@@ -0,0 +1,238 @@
+#include "FrameStatistics.hpp"
+#include <algorithm>
+#include <cassert>
+#include <fstream>
+
+//==============================================================================
+constexpr int FrameStatistics::RING_SIZE;
+constexpr float FrameStatistics::BUCKET_MS;
+constexpr int FrameStatistics::BUCKET_COUNT;
+
+//==============================================================================
+static float toMs(const std::chrono::steady_clock::duration duration)
+{
+    return std::chrono::duration<float, std::milli>{ duration }.count();
+}
+
+//==============================================================================
+FrameStatistics::FrameStatistics()
+{
+    for (auto & column : m_histogram)
+        for (auto & bucket : column)
+            bucket = 0;
+
+    for (auto & i : m_max) i = 0.0f;
+
+    m_current = {};
+    m_frame_begin = m_last_mark = Clock::now();
+}
+
+//==============================================================================
+void FrameStatistics::beginFrame()
+{
+    m_current = {};
+    m_frame_begin = m_last_mark = Clock::now();
+}
+
+//==============================================================================
+void FrameStatistics::endPhase(const Phase phase)
+{
+    assert(phase != Phase::last && "Invalid phase.");
+
+    const auto now = Clock::now();
+    m_current.phases[static_cast<int>(phase)] += toMs(now - m_last_mark);
+    m_last_mark = now;
+}
+
+//==============================================================================
+void FrameStatistics::endFrame()
+{
+    m_current.total = toMs(Clock::now() - m_frame_begin);
+
+    for (int i = 0; i < PHASE_COUNT; ++i)
+        addToHistogram(i, m_current.phases[i]);
+    addToHistogram(TOTAL, m_current.total);
+
+    // single producer: write slot first, then publish it
+    const auto count = m_count.load(std::memory_order_relaxed);
+    m_ring[count % RING_SIZE] = m_current;
+    m_count.store(count + 1, std::memory_order_release);
+}
+
+//==============================================================================
+void FrameStatistics::addToHistogram(const int column, const float value)
+{
+    const auto bucket = std::min(static_cast<int>(value / BUCKET_MS), BUCKET_COUNT - 1);
+    ++m_histogram[column][std::max(bucket, 0)];
+    m_max[column] = std::max(m_max[column], value);
+}
+
+//==============================================================================
+int FrameStatistics::copyRecent(const int window, const int column, float * destination) const
+{
+    const auto count = m_count.load(std::memory_order_acquire);
+    const auto size = std::min({ window, count, RING_SIZE / 2 }); // stay away from the slots that are being overwritten
+
+    for (int i = 0; i < size; ++i)
+    {
+        const auto & sample = m_ring[(count - 1 - i) % RING_SIZE];
+        destination[i] = column == TOTAL ? sample.total : sample.phases[column];
+    }
+
+    return size;
+}
+
+//==============================================================================
+static FrameStatistics::Percentiles percentilesOf(float * values, const int size)
+{
+    if (size == 0) return { 0.0f, 0.0f, 0.0f, 0.0f };
+
+    auto at = [&](const double percentile)
+    {
+        auto * nth = values + static_cast<int>(percentile * (size - 1));
+        std::nth_element(values, nth, values + size);
+        return *nth;
+    };
+
+    return { at(0.50), at(0.95), at(0.99), *std::max_element(values, values + size) };
+}
+
+//==============================================================================
+FrameStatistics::Percentiles FrameStatistics::recent(const int window, std::vector<float> & scratch) const
+{
+    return recentOf(TOTAL, window, scratch);
+}
+
+//==============================================================================
+FrameStatistics::Percentiles FrameStatistics::recent(const Phase phase, const int window, std::vector<float> & scratch) const
+{
+    return recentOf(static_cast<int>(phase), window, scratch);
+}
+
+//==============================================================================
+FrameStatistics::Percentiles FrameStatistics::recentOf(const int column, const int window, std::vector<float> & scratch) const
+{
+    const auto capacity = static_cast<std::size_t>(std::max(std::min(window, RING_SIZE / 2), 0));
+
+    if (scratch.size() < capacity)
+        scratch.resize(capacity);
+
+    return percentilesOf(scratch.data(), copyRecent(window, column, scratch.data()));
+}
+
+//==============================================================================
+FrameStatistics::Percentiles FrameStatistics::fromHistogram(const int column) const
+{
+    const auto count = m_count.load(std::memory_order_acquire);
+
+    if (count == 0) return { 0.0f, 0.0f, 0.0f, 0.0f };
+
+    auto at = [&](const double percentile)
+    {
+        const auto rank = static_cast<long long>(percentile * (count - 1));
+        long long seen = 0;
+
+        for (int i = 0; i < BUCKET_COUNT; ++i)
+        {
+            seen += m_histogram[column][i];
+            if (seen > rank)
+                return std::min((i + 1) * BUCKET_MS, m_max[column]); // upper bound of bucket
+        }
+
+        return m_max[column];
+    };
+
+    return { at(0.50), at(0.95), at(0.99), m_max[column] };
+}
+
+//==============================================================================
+FrameStatistics::Percentiles FrameStatistics::session() const
+{
+    return fromHistogram(TOTAL);
+}
+
+//==============================================================================
+FrameStatistics::Percentiles FrameStatistics::session(const Phase phase) const
+{
+    return fromHistogram(static_cast<int>(phase));
+}
+
+//==============================================================================
+const char * FrameStatistics::name(const Phase phase)
+{
+    switch (phase)
+    {
+        case Phase::POLL: return "poll";
+        case Phase::COMMANDS: return "commands";
+        case Phase::CULLING: return "culling";
+        case Phase::DRAW: return "draw";
+        case Phase::SWAP: return "swap";
+        case Phase::SLEEP: return "sleep";
+        default: return "invalid";
+    }
+}
+
+//==============================================================================
+bool FrameStatistics::dumpCSV(const std::string & file_name) const
+{
+    std::ofstream file{ file_name, std::ofstream::out | std::ofstream::trunc };
+
+    file << "frame,total";
+    for (int i = 0; i < PHASE_COUNT; ++i)
+        file << ',' << name(static_cast<Phase>(i));
+    file << '\n';
+
+    const auto count = m_count.load(std::memory_order_acquire);
+    const auto first = std::max(0, count - RING_SIZE);
+
+    for (int frame = first; frame < count; ++frame)
+    {
+        const auto & sample = m_ring[frame % RING_SIZE];
+
+        file << frame << ',' << sample.total;
+        for (const auto phase : sample.phases)
+            file << ',' << phase;
+        file << '\n';
+    }
+
+    return file.good();
+}
+
+//==============================================================================
+bool FrameStatistics::dumpJSON(const std::string & file_name) const
+{
+    std::ofstream file{ file_name, std::ofstream::out | std::ofstream::trunc };
+
+    auto write_column = [&](const char * column_name, const int column)
+    {
+        const auto p = fromHistogram(column);
+
+        file << "    \"" << column_name << "\": { "
+             << "\"p50\": " << p.p50 << ", \"p95\": " << p.p95 << ", \"p99\": " << p.p99 << ", \"max\": " << p.max
+             << ", \"histogram\": {";
+
+        bool first = true;
+        for (int i = 0; i < BUCKET_COUNT; ++i)
+        {
+            if (m_histogram[column][i] == 0) continue;
+
+            file << (first ? " " : ", ") << '"' << i * BUCKET_MS << "\": " << m_histogram[column][i];
+            first = false;
+        }
+
+        file << " } }";
+    };
+
+    file << "{\n  \"frames\": " << frameCount() << ",\n  \"bucket_ms\": " << BUCKET_MS << ",\n  \"phases\": {\n";
+
+    write_column("total", TOTAL);
+    for (int i = 0; i < PHASE_COUNT; ++i)
+    {
+        file << ",\n";
+        write_column(name(static_cast<Phase>(i)), i);
+    }
+
+    file << "\n  }\n}\n";
+
+    return file.good();
+}
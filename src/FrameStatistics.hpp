@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+
+// Frame time capture for tail latency measurements.
+// Only the render thread may call beginFrame(), endPhase() and endFrame().
+// Reading (percentiles, dumps) is lock free and can be done from any thread,
+// as long as the read window is small compared to the ring capacity.
+
+//==============================================================================
+class FrameStatistics
+{
+public:
+    enum class Phase : int { POLL, COMMANDS, CULLING, DRAW, SWAP, SLEEP, last };
+    static constexpr int PHASE_COUNT{ static_cast<int>(Phase::last) };
+
+    // all times are in milliseconds
+    struct Sample { float total; float phases[PHASE_COUNT]; };
+    struct Percentiles { float p50, p95, p99, max; };
+
+    FrameStatistics();
+
+    void beginFrame();
+    void endPhase(const Phase phase); // time since last mark is accounted to phase
+    void endFrame();
+
+    // percentiles of the last window frames (ring buffer)
+    // scratch is grown to the window once and reused, so polling every frame does not allocate
+    Percentiles recent(const int window, std::vector<float> & scratch) const;
+    Percentiles recent(const Phase phase, const int window, std::vector<float> & scratch) const;
+
+    // percentiles of the whole session (histogram)
+    Percentiles session() const;
+    Percentiles session(const Phase phase) const;
+
+    int frameCount() const { return m_count.load(std::memory_order_acquire); }
+
+    bool dumpCSV(const std::string & file_name) const; // one line per frame in the ring
+    bool dumpJSON(const std::string & file_name) const; // session summary + histogram
+
+    static const char * name(const Phase phase);
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr int RING_SIZE{ 1 << 14 };
+    static constexpr float BUCKET_MS{ 0.1f };
+    static constexpr int BUCKET_COUNT{ 2000 }; // last bucket collects everything above 200 ms
+    static constexpr int TOTAL{ PHASE_COUNT }; // histogram index of the whole frame
+
+    Sample m_ring[RING_SIZE];
+    std::atomic_int m_count{ 0 }; // frames committed to ring
+
+    int m_histogram[PHASE_COUNT + 1][BUCKET_COUNT];
+    float m_max[PHASE_COUNT + 1];
+
+    Sample m_current;
+    Clock::time_point m_frame_begin;
+    Clock::time_point m_last_mark;
+
+    int copyRecent(const int window, const int column, float * destination) const;
+    Percentiles recentOf(const int column, const int window, std::vector<float> & scratch) const;
+    Percentiles fromHistogram(const int column) const;
+    void addToHistogram(const int column, const float value);
+
+};
@@ -0,0 +1,166 @@
+#include "InputRecording.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <stdexcept>
+
+//==============================================================================
+static constexpr char MAGIC[4]{ 'V', 'X', 'I', 'N' };
+static constexpr uint32_t VERSION{ 2 }; // 2: camera origin
+
+//==============================================================================
+constexpr float InputPlayback::POSITION_TOLERANCE;
+
+//==============================================================================
+template<typename T>
+static void write(std::ofstream & file, const T & value)
+{
+    file.write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+//==============================================================================
+template<typename T>
+static void read(std::ifstream & file, T & value)
+{
+    file.read(reinterpret_cast<char *>(&value), sizeof(value));
+}
+
+//==============================================================================
+static void writeCamera(std::ofstream & file, const Player & player)
+{
+    const auto origin = player.getOrigin();
+    const auto position = player.getPosition();
+
+    write(file, static_cast<int32_t>(origin[0]));
+    write(file, static_cast<int32_t>(origin[1]));
+    write(file, static_cast<int32_t>(origin[2]));
+    write(file, position.x);
+    write(file, position.y);
+    write(file, position.z);
+    write(file, player.getYaw());
+    write(file, player.getPitch());
+}
+
+//==============================================================================
+InputRecorder::InputRecorder(const std::string & file_name, const double tick_rate, const Player & player) :
+    m_file{ file_name, std::ios::binary | std::ios::trunc }
+{
+    if (!m_file)
+        throw std::runtime_error("Creating input recording " + file_name + " failed.");
+
+    m_file.write(MAGIC, sizeof(MAGIC));
+    write(m_file, VERSION);
+    write(m_file, tick_rate);
+    writeCamera(m_file, player);
+}
+
+//==============================================================================
+void InputRecorder::record(const Player::Input & input, const Player & player)
+{
+    // 45 bytes per step
+    write(m_file, input.keys);
+    write(m_file, input.look_x);
+    write(m_file, input.look_y);
+    write(m_file, input.speed);
+    writeCamera(m_file, player);
+
+    ++m_ticks;
+}
+
+//==============================================================================
+InputPlayback::InputPlayback(const std::string & file_name, const double tick_rate)
+{
+    std::ifstream file{ file_name, std::ios::binary };
+
+    if (!file)
+        throw std::runtime_error("Opening input recording " + file_name + " failed.");
+
+    char magic[sizeof(MAGIC)];
+    uint32_t version;
+    double recorded_tick_rate;
+
+    file.read(magic, sizeof(magic));
+    read(file, version);
+    read(file, recorded_tick_rate);
+
+    if (!file || !std::equal(magic, magic + sizeof(magic), MAGIC) || version != VERSION)
+        throw std::runtime_error("Input recording " + file_name + " has an unexpected format.");
+
+    // steps of another length fly another path
+    if (recorded_tick_rate != tick_rate)
+        throw std::runtime_error("Input recording " + file_name + " was made at another tick rate.");
+
+    const auto readCamera = [&file](Camera & camera)
+    {
+        for (auto & o : camera.origin) read(file, o);
+        for (auto & p : camera.position) read(file, p);
+        read(file, camera.yaw);
+        read(file, camera.pitch);
+    };
+
+    readCamera(m_start);
+
+    while (true)
+    {
+        Tick tick;
+
+        read(file, tick.input.keys);
+        read(file, tick.input.look_x);
+        read(file, tick.input.look_y);
+        read(file, tick.input.speed);
+        readCamera(tick.camera);
+
+        // a partly written last step is dropped
+        if (!file)
+            break;
+
+        m_ticks.push_back(tick);
+    }
+}
+
+//==============================================================================
+void InputPlayback::start(Player & player) const
+{
+    player.setState(
+        i32Vec3{ m_start.origin[0], m_start.origin[1], m_start.origin[2] },
+        { m_start.position[0], m_start.position[1], m_start.position[2] },
+        m_start.yaw, m_start.pitch
+    );
+}
+
+//==============================================================================
+bool InputPlayback::next(Player::Input & input)
+{
+    if (m_next >= m_ticks.size())
+        return false;
+
+    input = m_ticks[m_next++].input;
+
+    return true;
+}
+
+//==============================================================================
+void InputPlayback::check(const Player & player)
+{
+    assert(m_next > 0 && "No step played yet.");
+
+    const auto & recorded = m_ticks[m_next - 1].camera;
+    const auto origin = player.getOrigin();
+    const auto position = player.getPosition();
+    bool same = true;
+
+    // origins may differ if a rebase happened at another step
+    for (int i = 0; i < 3; ++i)
+    {
+        const auto difference = static_cast<double>(origin[i] - recorded.origin[i]) + static_cast<double>(position[i] - recorded.position[i]);
+        same = same && std::abs(difference) <= POSITION_TOLERANCE;
+    }
+
+    if (same)
+        return;
+
+    if (m_first_divergence == -1)
+        m_first_divergence = static_cast<long long>(m_next - 1);
+
+    ++m_diverged;
+}
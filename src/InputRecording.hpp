@@ -0,0 +1,57 @@
+#pragma once
+
+#include "Player.hpp"
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Player input of every simulation step and where the camera was after it, in a compact binary file:
+// a header with the tick rate and the camera at the start, then one fixed size record per step.
+// Played back at the same tick rate, a recording flies the same path in every build, as long as the
+// terrain the player collides with is loaded in time. check() finds the steps where it was not.
+// Fields are stored in the byte order of the machine.
+
+//==============================================================================
+class InputRecorder
+{
+public:
+    InputRecorder(const std::string & file_name, const double tick_rate, const Player & player); // player at the start
+
+    void record(const Player::Input & input, const Player & player); // player after the step
+
+    long long ticks() const { return m_ticks; }
+
+private:
+    std::ofstream m_file;
+    long long m_ticks{ 0 };
+
+};
+
+//==============================================================================
+class InputPlayback
+{
+public:
+    InputPlayback(const std::string & file_name, const double tick_rate);
+
+    void start(Player & player) const; // moves the player to where the recording starts
+    bool next(Player::Input & input); // false after the last step
+    void check(const Player & player); // player after the step
+
+    long long ticks() const { return static_cast<long long>(m_ticks.size()); }
+    long long divergedTicks() const { return m_diverged; }
+    long long firstDivergence() const { return m_first_divergence; } // -1 if it never diverged
+
+private:
+    struct Camera { int32_t origin[3]; float position[3]; float yaw, pitch; }; // like Player
+    struct Tick { Player::Input input; Camera camera; };
+
+    static constexpr float POSITION_TOLERANCE{ 0.001f }; // in blocks
+
+    Camera m_start;
+    std::vector<Tick> m_ticks;
+    std::size_t m_next{ 0 };
+    long long m_diverged{ 0 };
+    long long m_first_divergence{ -1 };
+
+};
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "MemoryBlockUnit.hpp"
+#include <utility>
 
 // Warning: Calling member functions is not thread safe. Accessing stored data is thread safe (will not be moved)
 
@@ -12,6 +13,18 @@ class MemoryBlock
 public:
     MemoryBlock() {}
 
+    MemoryBlock(const MemoryBlock &) = delete;
+    MemoryBlock & operator = (const MemoryBlock &) = delete;
+
+    // stored data stays where it is, only the ownership moves
+    MemoryBlock(MemoryBlock && other) { std::swap(m_first, other.m_first); }
+    MemoryBlock & operator = (MemoryBlock && other)
+    {
+        reset();
+        std::swap(m_first, other.m_first);
+        return *this;
+    }
+
     void reset()
     {
         this->~MemoryBlock();
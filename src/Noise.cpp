@@ -0,0 +1,168 @@
+#include "Noise.hpp"
+#include "PositionRandom.hpp"
+#include <cassert>
+
+//==============================================================================
+constexpr int Noise::MAX_COUNT;
+
+//==============================================================================
+static inline int32_t fastFloor(const float value)
+{
+    const auto truncated = static_cast<int32_t>(value);
+    return truncated - (value < static_cast<float>(truncated) ? 1 : 0);
+}
+
+//==============================================================================
+static inline float corner(const float x, const float y, const uint32_t hash)
+{
+    // 8 gradients, (±1, ±2) and (±2, ±1) (Gustavson)
+    const auto h = hash >> 29;
+    const auto u = h < 4 ? x : y;
+    const auto v = h < 4 ? y : x;
+    const auto gradient = ((h & 1) ? -u : u) + ((h & 2) ? -2.0f * v : 2.0f * v);
+
+    auto t = 0.5f - x * x - y * y;
+    t = t < 0.0f ? 0.0f : t;
+    t *= t;
+
+    return t * t * gradient;
+}
+
+//==============================================================================
+static inline float corner(const float x, const float y, const float z, const uint32_t hash)
+{
+    // 12 edge gradients, 4 of them twice (Perlin)
+    const auto h = hash >> 28;
+    const auto u = h < 8 ? x : y;
+    const auto v = h < 4 ? y : (h == 12 || h == 14 ? x : z);
+    const auto gradient = ((h & 1) ? -u : u) + ((h & 2) ? -v : v);
+
+    auto t = 0.6f - x * x - y * y - z * z;
+    t = t < 0.0f ? 0.0f : t;
+    t *= t;
+
+    return t * t * gradient;
+}
+
+//==============================================================================
+void Noise::simplex2D(float * destination, const float * x, const float * y, const int count, const uint32_t seed)
+{
+    constexpr float F2{ 0.366025403f }; // (sqrt(3) - 1) / 2
+    constexpr float G2{ 0.211324865f }; // (3 - sqrt(3)) / 6
+
+    for (int n = 0; n < count; ++n)
+    {
+        // skew into the simplex grid and find the containing triangle
+        const auto s = (x[n] + y[n]) * F2;
+        const auto i = fastFloor(x[n] + s);
+        const auto j = fastFloor(y[n] + s);
+
+        const auto t = static_cast<float>(i + j) * G2;
+        const auto x0 = x[n] - (static_cast<float>(i) - t);
+        const auto y0 = y[n] - (static_cast<float>(j) - t);
+
+        const int32_t i1 = x0 > y0 ? 1 : 0;
+        const int32_t j1 = 1 - i1;
+
+        const auto x1 = x0 - static_cast<float>(i1) + G2;
+        const auto y1 = y0 - static_cast<float>(j1) + G2;
+        const auto x2 = x0 - 1.0f + 2.0f * G2;
+        const auto y2 = y0 - 1.0f + 2.0f * G2;
+
+        const auto sum =
+            corner(x0, y0, PositionRandom::of(seed, i, j, 0)) +
+            corner(x1, y1, PositionRandom::of(seed, i + i1, j + j1, 0)) +
+            corner(x2, y2, PositionRandom::of(seed, i + 1, j + 1, 0));
+
+        destination[n] = 40.0f * sum;
+    }
+}
+
+//==============================================================================
+void Noise::simplex3D(float * destination, const float * x, const float * y, const float * z, const int count, const uint32_t seed)
+{
+    constexpr float F3{ 1.0f / 3.0f };
+    constexpr float G3{ 1.0f / 6.0f };
+
+    for (int n = 0; n < count; ++n)
+    {
+        // skew into the simplex grid and find the containing tetrahedron
+        const auto s = (x[n] + y[n] + z[n]) * F3;
+        const auto i = fastFloor(x[n] + s);
+        const auto j = fastFloor(y[n] + s);
+        const auto k = fastFloor(z[n] + s);
+
+        const auto t = static_cast<float>(i + j + k) * G3;
+        const auto x0 = x[n] - (static_cast<float>(i) - t);
+        const auto y0 = y[n] - (static_cast<float>(j) - t);
+        const auto z0 = z[n] - (static_cast<float>(k) - t);
+
+        // order of the offsets without branches
+        const bool xy = x0 >= y0, xz = x0 >= z0, yz = y0 >= z0;
+        const int32_t i1 = xy & xz, j1 = !xy & yz, k1 = !xz & !yz;
+        const int32_t i2 = xy | xz, j2 = !xy | yz, k2 = !xz | !yz;
+
+        const auto x1 = x0 - static_cast<float>(i1) + G3;
+        const auto y1 = y0 - static_cast<float>(j1) + G3;
+        const auto z1 = z0 - static_cast<float>(k1) + G3;
+        const auto x2 = x0 - static_cast<float>(i2) + 2.0f * G3;
+        const auto y2 = y0 - static_cast<float>(j2) + 2.0f * G3;
+        const auto z2 = z0 - static_cast<float>(k2) + 2.0f * G3;
+        const auto x3 = x0 - 1.0f + 3.0f * G3;
+        const auto y3 = y0 - 1.0f + 3.0f * G3;
+        const auto z3 = z0 - 1.0f + 3.0f * G3;
+
+        const auto sum =
+            corner(x0, y0, z0, PositionRandom::of(seed, i, j, k)) +
+            corner(x1, y1, z1, PositionRandom::of(seed, i + i1, j + j1, k + k1)) +
+            corner(x2, y2, z2, PositionRandom::of(seed, i + i2, j + j2, k + k2)) +
+            corner(x3, y3, z3, PositionRandom::of(seed, i + 1, j + 1, k + 1));
+
+        destination[n] = 32.0f * sum;
+    }
+}
+
+//==============================================================================
+void Noise::fractal2D(float * destination, const float * x, const float * y, const int count, const uint32_t seed, const int octaves, const float lacunarity, const float gain)
+{
+    assert(count <= MAX_COUNT && "Too many points.");
+
+    float octave_x[MAX_COUNT], octave_y[MAX_COUNT], octave[MAX_COUNT];
+
+    for (int n = 0; n < count; ++n)
+        destination[n] = 0.0f;
+
+    float frequency = 1.0f, amplitude = 1.0f;
+
+    for (int o = 0; o < octaves; ++o)
+    {
+        for (int n = 0; n < count; ++n)
+        {
+            octave_x[n] = x[n] * frequency;
+            octave_y[n] = y[n] * frequency;
+        }
+
+        // every octave gets its own noise, otherwise features line up at the origin
+        simplex2D(octave, octave_x, octave_y, count, seed + static_cast<uint32_t>(o) * 0x9E3779B9u);
+
+        for (int n = 0; n < count; ++n)
+            destination[n] += octave[n] * amplitude;
+
+        frequency *= lacunarity;
+        amplitude *= gain;
+    }
+}
+
+//==============================================================================
+float Noise::amplitudeSum(const int octaves, const float gain)
+{
+    float sum = 0.0f, amplitude = 1.0f;
+
+    for (int o = 0; o < octaves; ++o)
+    {
+        sum += amplitude;
+        amplitude *= gain;
+    }
+
+    return sum;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+
+// 2D and 3D simplex noise evaluated on arrays of points, results roughly in [-1, 1].
+// Gradients come from hashing the lattice points (PositionRandom) instead of a permutation
+// table, and there are no branches, so the loops vectorize (SSE2 by default, AVX2 with
+// VOXEL_NATIVE_ARCH). Different seeds give unrelated noise.
+
+//==============================================================================
+class Noise
+{
+public:
+    static void simplex2D(float * destination, const float * x, const float * y, const int count, const uint32_t seed);
+    static void simplex3D(float * destination, const float * x, const float * y, const float * z, const int count, const uint32_t seed);
+
+    // sum of octaves, each with lacunarity times the frequency and gain times the amplitude of the previous one.
+    // the result is in [-amplitude_sum, amplitude_sum], see amplitudeSum()
+    static void fractal2D(float * destination, const float * x, const float * y, const int count, const uint32_t seed, const int octaves, const float lacunarity, const float gain);
+    static float amplitudeSum(const int octaves, const float gain);
+
+    static constexpr int MAX_COUNT{ 256 }; // points per call, a chunk column layer of 16 x 16
+
+};
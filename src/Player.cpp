@@ -5,7 +5,10 @@
 //==============================================================================
 //
 #include "Player.hpp"
+#include "World.hpp"
 
+#include <algorithm>
+#include <limits>
 #include <glm/gtx/projection.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include "Keyboard.hpp"
@@ -22,6 +25,9 @@ const float Player::SPEED_DEAFULT{ 200.0f };
 const float Player::SPEED_CHANGE_FACTOR{ 3.0f };
 const float Player::TIME_TO_MAX_SPEED{ 0.15f };
 const glm::vec3 Player::WORLD_UP{ 0.0f, 1.0f, 0.0f };
+const float Player::COLLISION_SKIN{ 0.001f }; // in blocks
+const int Player::COLLISION_ROUNDS{ 3 }; // one per axis
+const float Player::REBASE_DISTANCE{ 16.0f }; // in blocks
 const float Player::MAX_PITCH{ (PI<float> / 2.0f) - 0.001f };
 const float Player::INVERSE_MOUSE_SENSITIVITY{ 200.0f };
 
@@ -32,11 +38,78 @@ Player::Player() : Player{ { 0.0f, 15.0f, 0.0f}, 0.5f * 3.14f, 0.0f } {}
 Player::Player(glm::vec3 position, float yaw, float pitch) :
   m_speed{ Player::SPEED_DEAFULT },
   m_position{ position },
-  //m_last_position{ position },
+  m_last_position{ position },
   m_velocity{ glm::vec3{ 0.0f, 0.0f, 0.0f } },
   m_yaw{ yaw },
   m_pitch{ pitch }
 {
+  rebase();
+}
+
+//==============================================================================
+Player::Input Player::readDevices(const float speed)
+{
+  const auto key = [](const int glfw_key, const Input::Key input_key)
+  {
+    return Keyboard::getKey(glfw_key) == Keyboard::Status::PRESSED ? input_key : 0;
+  };
+
+  const auto movement = Mouse::getPointerMovement();
+
+  Input input;
+  input.keys = static_cast<unsigned char>(
+    key(GLFW_KEY_U, Input::FORWARD) | key(GLFW_KEY_J, Input::BACKWARD) |
+    key(GLFW_KEY_K, Input::RIGHT) | key(GLFW_KEY_H, Input::LEFT) |
+    key(GLFW_KEY_L, Input::UP) | key(GLFW_KEY_SPACE, Input::DOWN)
+  );
+  input.look_x = static_cast<float>(movement[0]);
+  input.look_y = static_cast<float>(movement[1]);
+  input.speed = speed;
+
+  return input;
+}
+
+//==============================================================================
+void Player::setInput(const Input & input)
+{
+  m_input = input;
+  updateSpeed(input.speed);
+}
+
+//==============================================================================
+void Player::setState(const i32Vec3 origin, const glm::vec3 position, const float yaw, const float pitch)
+{
+  m_origin = origin;
+  m_position = position;
+  m_last_position = position;
+  m_velocity = glm::vec3{ 0.0f, 0.0f, 0.0f };
+  m_yaw = yaw;
+  m_pitch = pitch;
+
+  rebase();
+  updateCameraRotation();
+}
+
+//==============================================================================
+i32Vec3 Player::getBlockPosition() const
+{
+  const glm::vec3 block{ glm::floor(m_position) };
+
+  return m_origin + i32Vec3{ static_cast<int>(block.x), static_cast<int>(block.y), static_cast<int>(block.z) };
+}
+
+//==============================================================================
+void Player::rebase()
+{
+  if (std::abs(m_position.x) < REBASE_DISTANCE && std::abs(m_position.y) < REBASE_DISTANCE && std::abs(m_position.z) < REBASE_DISTANCE)
+    return;
+
+  // small floats minus whole numbers are exact, the path does not change
+  const glm::vec3 shift{ glm::floor(m_position) };
+
+  m_position -= shift;
+  m_last_position -= shift;
+  m_origin += i32Vec3{ static_cast<int>(shift.x), static_cast<int>(shift.y), static_cast<int>(shift.z) };
 }
 
 //==============================================================================
@@ -51,10 +124,8 @@ void Player::updateCameraAndItems()
 //==============================================================================
 void Player::updateFacingDirection()
 {
-  const auto movement = Mouse::getPointerMovement();
-
   const glm::vec2 offset{
-     glm::vec2{ movement[0], - movement[1] } / INVERSE_MOUSE_SENSITIVITY
+     glm::vec2{ m_input.look_x, - m_input.look_y } / INVERSE_MOUSE_SENSITIVITY
   };
 
   m_yaw += offset.x;
@@ -207,94 +278,107 @@ void Player::updateVelocity(float delta_time)
 
 
 //==============================================================================
-void Player::applyVelocity(float delta_time)
+void Player::applyVelocity(float delta_time, World & world)
 {
-  // Euler integration
-
-  //m_last_position = m_position;
-#if 1
-  m_position += m_velocity * delta_time;
-#else
-  //m_position += m_velocity * delta_time;
-  /*
-  // DO NOT USE
-  Ray movement{ m_position, m_velocity * delta_time };
-  m_position = movement.collisionResponse(world);
-  */
-  //-------------------------
-  float rest_time = delta_time;
-NEW_ROUND:
-  if (rest_time < 0.001f) return;
-  const glm::vec3 player_pos = m_position + m_velocity * rest_time;
+  m_last_position = m_position;
 
+  glm::vec3 motion{ m_velocity * delta_time };
 
-  const AABB player{
-    player_pos - player_size,
-    player_pos + player_size,
-  };
-  const AABB player_before{
-    m_position - player_size,
-    m_position + player_size,
-  };
+  // broadphase: every block the box can touch during this step, it is a handful of chunks
+  const glm::vec3 sweep_min{ glm::min(m_position, m_position + motion) - player_size };
+  const glm::vec3 sweep_max{ glm::max(m_position, m_position + motion) + player_size };
+  const glm::ivec3 from{ glm::floor(sweep_min) };
+  const glm::ivec3 to{ glm::ivec3{ glm::floor(sweep_max) } + 1 };
 
-  // could be converted to AABB<int> <- template
-  const glm::ivec3 player_min{
-    Math::floor(player.getMin().x),
-    Math::floor(player.getMin().y),
-    Math::floor(player.getMin().z)
-  };
+  const auto view = world.view(m_origin + i32Vec3{ from.x, from.y, from.z }, m_origin + i32Vec3{ to.x, to.y, to.z });
 
-  const glm::ivec3 player_max{
-    Math::floor(player.getMax().x),
-    Math::floor(player.getMax().y),
-    Math::floor(player.getMax().z)
-  };
+  m_on_ground = false;
 
-  AABB::Collision first_collision{ 1.0f,{ 1.0f, 1.0f, 1.0f } };
-  glm::ivec3 block_pos;
-  for (block_pos.z = player_min.z; block_pos.z <= player_max.z; ++block_pos.z)
-    for (block_pos.y = player_min.y; block_pos.y <= player_max.y; ++block_pos.y)
-      for (block_pos.x = player_min.x; block_pos.x <= player_max.x; ++block_pos.x)
-      {
-        if (world.getBlock(block_pos) == false) continue;
+  // move up to the first block hit, drop the velocity into its face and slide on with the rest
+  for (int round = 0; round < COLLISION_ROUNDS; ++round)
+  {
+    float first_time{ 1.0f };
+    int first_axis{ -1 };
+    glm::ivec3 block;
 
-        const AABB block{ // cast to float
-          block_pos,
-          glm::vec3{ block_pos } +glm::vec3{ 1.0f, 1.0f, 1.0f }
-        };
+    for (block.z = from.z; block.z < to.z; ++block.z)
+      for (block.y = from.y; block.y < to.y; ++block.y)
+        for (block.x = from.x; block.x < to.x; ++block.x)
+        {
+          if (!view.solid(m_origin + i32Vec3{ block.x, block.y, block.z }))
+            continue;
 
-        /*
-        float distance = AABB::distance(block, player);
+          int axis;
+          const float time{ collisionTime(motion, block, axis) };
 
-        if (distance < 0.0f)
-        {
-        m_position = m_last_position;
-        return;
+          if (time < first_time)
+          {
+            first_time = time;
+            first_axis = axis;
+          }
         }
-        */
-        AABB::Collision this_collision{ AABB::collisionTime(player_before, m_velocity, block) };
 
-        if (first_collision.time > this_collision.time)
-          first_collision = this_collision;
+    if (first_axis == -1)
+    {
+      m_position += motion;
+      break;
+    }
 
-      }
+    // stop short of the face, touching after rounding would count as being inside
+    const float stop_time{ std::max(0.0f, first_time - COLLISION_SKIN / std::abs(motion[first_axis])) };
+    m_position += motion * stop_time;
 
-  if (first_collision.time < 1.0f)
-  {
-    if (first_collision.face.y == 0.0f && m_velocity.y < 0.0f)
+    if (first_axis == 1 && motion.y < 0.0f)
       m_on_ground = true;
-    m_position += m_velocity * rest_time * first_collision.time;
-    m_velocity *= first_collision.face;
-    rest_time -= first_collision.time * rest_time;
 
-
-    goto NEW_ROUND;
+    motion *= 1.0f - stop_time;
+    motion[first_axis] = 0.0f;
+    m_velocity[first_axis] = 0.0f;
   }
-  else
+
+  rebase();
+}
+
+//==============================================================================
+float Player::collisionTime(const glm::vec3 & motion, const glm::ivec3 & block, int & axis) const
+{
+  // swept AABB: fraction of motion until the box meets the block, 1 if it does not
+  const glm::vec3 box_min{ m_position - player_size };
+  const glm::vec3 box_max{ m_position + player_size };
+  const glm::vec3 block_min{ block };
+  const glm::vec3 block_max{ block_min + 1.0f };
+
+  float entry{ -std::numeric_limits<float>::infinity() };
+  float exit{ std::numeric_limits<float>::infinity() };
+  axis = -1;
+
+  for (int i = 0; i < 3; ++i)
   {
-    m_position += m_velocity * rest_time * first_collision.time;
+    if (motion[i] == 0.0f)
+    {
+      if (box_max[i] <= block_min[i] || box_min[i] >= block_max[i])
+        return 1.0f;
+
+      continue;
+    }
+
+    const float enter_time{ (motion[i] > 0.0f ? block_min[i] - box_max[i] : block_max[i] - box_min[i]) / motion[i] };
+    const float leave_time{ (motion[i] > 0.0f ? block_max[i] - box_min[i] : block_min[i] - box_max[i]) / motion[i] };
+
+    if (enter_time > entry)
+    {
+      entry = enter_time;
+      axis = i;
+    }
+
+    exit = std::min(exit, leave_time);
   }
-#endif
+
+  // entry < 0 means the box is inside the block already (new terrain), it may move out freely
+  if (axis == -1 || entry < 0.0f || entry >= exit || entry >= 1.0f)
+    return 1.0f;
+
+  return entry;
 }
 
 //==============================================================================
@@ -310,9 +394,9 @@ bool Player::getAcceleration(glm::vec3 & acceleration) const
 {
   bool accelerating = false;
 
-  if (Keyboard::getKey(GLFW_KEY_U) != Keyboard::getKey(GLFW_KEY_J))
+  if (m_input.pressed(Input::FORWARD) != m_input.pressed(Input::BACKWARD))
   {
-    if (Keyboard::getKey(GLFW_KEY_U) == Keyboard::Status::PRESSED)
+    if (m_input.pressed(Input::FORWARD))
       acceleration += m_front;
     else
       acceleration -= m_front;
@@ -320,9 +404,9 @@ bool Player::getAcceleration(glm::vec3 & acceleration) const
     accelerating = true;
   }
 
-  if (Keyboard::getKey(GLFW_KEY_K) != Keyboard::getKey(GLFW_KEY_H))
+  if (m_input.pressed(Input::RIGHT) != m_input.pressed(Input::LEFT))
   {
-    if (Keyboard::getKey(GLFW_KEY_K) == Keyboard::Status::PRESSED)
+    if (m_input.pressed(Input::RIGHT))
       acceleration += m_right;
     else
       acceleration -= m_right;
@@ -330,9 +414,9 @@ bool Player::getAcceleration(glm::vec3 & acceleration) const
     accelerating = true;
   }
 
-  if (Keyboard::getKey(GLFW_KEY_L) != Keyboard::getKey(GLFW_KEY_SPACE))
+  if (m_input.pressed(Input::UP) != m_input.pressed(Input::DOWN))
   {
-    if (Keyboard::getKey(GLFW_KEY_L) == Keyboard::Status::PRESSED)
+    if (m_input.pressed(Input::UP))
       acceleration += Player::WORLD_UP;
     else
       acceleration -= Player::WORLD_UP;
@@ -353,9 +437,9 @@ glm::vec3 Player::getPlayerForce(const glm::vec3 & force_to_stop) const
   glm::vec3 force{ 0.0f, 0.0f, 0.0f };
 
   //----------------------------------
-  if (Keyboard::getKey(GLFW_KEY_U) != Keyboard::getKey(GLFW_KEY_J))
+  if (m_input.pressed(Input::FORWARD) != m_input.pressed(Input::BACKWARD))
   {
-    if (Keyboard::getKey(GLFW_KEY_U) == Keyboard::Status::PRESSED)
+    if (m_input.pressed(Input::FORWARD))
       force += m_front;
     else
       force -= m_front;
@@ -381,9 +465,9 @@ glm::vec3 Player::getPlayerForce(const glm::vec3 & force_to_stop) const
     }
   }
   //----------------------------------
-  if (Keyboard::getKey(GLFW_KEY_K) != Keyboard::getKey(GLFW_KEY_H))
+  if (m_input.pressed(Input::RIGHT) != m_input.pressed(Input::LEFT))
   {
-    if (Keyboard::getKey(GLFW_KEY_K) == Keyboard::Status::PRESSED)
+    if (m_input.pressed(Input::RIGHT))
       force += m_right;
     else
       force -= m_right;
@@ -411,9 +495,9 @@ glm::vec3 Player::getPlayerForce(const glm::vec3 & force_to_stop) const
   //----------------------------------
   if (m_gravitation == true)
     goto EXIT;
-  if (Keyboard::getKey(GLFW_KEY_L) != Keyboard::getKey(GLFW_KEY_SPACE))
+  if (m_input.pressed(Input::UP) != m_input.pressed(Input::DOWN))
   {
-    if (Keyboard::getKey(GLFW_KEY_L) == Keyboard::Status::PRESSED)
+    if (m_input.pressed(Input::UP))
       force += Player::WORLD_UP;
     else
       force -= Player::WORLD_UP;
@@ -454,7 +538,7 @@ glm::vec3 Player::getPlayerImpulse()
   if (
     m_on_ground
     &&
-    Keyboard::getKey(GLFW_KEY_SPACE) == Keyboard::Status::PRESSED
+    m_input.pressed(Input::DOWN)
     &&
     m_gravitation == true
     )
@@ -8,21 +8,44 @@
 
 // TODO: refactor
 
+#include "Algebra.hpp"
 #include <glm/glm.hpp>
 
+class World;
+
 class Player
 {
 public:
+    // what the player does in one step, read from the devices or from a recording
+    struct Input
+    {
+        enum Key : unsigned char { FORWARD = 1 << 0, BACKWARD = 1 << 1, RIGHT = 1 << 2, LEFT = 1 << 3, UP = 1 << 4, DOWN = 1 << 5 };
+
+        unsigned char keys;
+        float look_x, look_y; // pointer movement
+        float speed; // share of SPEED_MAX
+
+        bool pressed(const Key key) const { return (keys & key) != 0; }
+    };
+
     Player();
     Player(glm::vec3 position, float yaw, float pitch);
 
+    static Input readDevices(const float speed); // takes the pointer movement since the last call
+    void setInput(const Input & input); // for the next step
+    void setState(const i32Vec3 origin, const glm::vec3 position, const float yaw, const float pitch); // stops the player there
+
+    // positions are relative to an integer origin that follows the player, so they stay exact far out
+    i32Vec3 getOrigin() const { return m_origin; }
     glm::vec3 getPosition() const { return m_position; }
+    glm::vec3 getInterpolatedPosition(const float alpha) const { return glm::mix(m_last_position, m_position, alpha); } // between the last two steps
+    i32Vec3 getBlockPosition() const; // absolute
     glm::vec3 getVelocity() const { return m_velocity; }
     glm::vec3 getViewDirection() const { return m_facing; }
 
     void updateCameraAndItems();
     void updateVelocity(float delta_time);
-    void applyVelocity(float delta_time);
+    void applyVelocity(float delta_time, World & world); // slides along solid blocks
     void maskVelocity(glm::vec3 mask);
 
     float getYaw() const { return m_yaw; }
@@ -44,11 +67,18 @@ private:
     static const float SPEED_CHANGE_FACTOR;
     static const float TIME_TO_MAX_SPEED;
     static const glm::vec3 WORLD_UP;
+    static const float COLLISION_SKIN;
+    static const int COLLISION_ROUNDS;
+    static const float REBASE_DISTANCE;
 
     bool m_gravitation{ false };
 
     bool m_on_ground{ false };
 
+    Input m_input{ 0, 0.0f, 0.0f, 0.0f };
+
+    float collisionTime(const glm::vec3 & motion, const glm::ivec3 & block, int & axis) const;
+    void rebase(); // moves whole blocks from the position to the origin
 
     bool getAcceleration(glm::vec3 & acceleration) const;
     glm::vec3 getPlayerForce(const glm::vec3 & force_to_stop) const;
@@ -62,8 +92,9 @@ private:
     float m_speed;
 
     // Camera position
+    i32Vec3 m_origin{ 0, 0, 0 };
     glm::vec3 m_position;
-    //glm::vec3 m_last_position;
+    glm::vec3 m_last_position; // before the last applyVelocity()
     glm::vec3 m_velocity;
 
     // Euler angles
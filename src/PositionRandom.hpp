@@ -0,0 +1,28 @@
+#pragma once
+
+#include "Algebra.hpp"
+#include <cstdint>
+
+// Counter based random numbers: the value is a pure function of seed and block position,
+// so terrain is the same no matter which thread generates it, or when, or how often.
+// No shared state and no branches, a loop over x vectorizes (32 bit multiplies only).
+
+//==============================================================================
+class PositionRandom
+{
+public:
+    static constexpr uint32_t of(const uint32_t seed, const int32_t x, const int32_t y, const int32_t z)
+    {
+        // spread the position with odd constants, then a full avalanche mix (lowbias32 finalizer)
+        uint32_t h = seed ^ static_cast<uint32_t>(x) * 0x9E3779B1u ^ static_cast<uint32_t>(y) * 0x85EBCA77u ^ static_cast<uint32_t>(z) * 0xC2B2AE3Du;
+        h ^= h >> 16;
+        h *= 0x7FEB352Du;
+        h ^= h >> 15;
+        h *= 0x846CA68Bu;
+        h ^= h >> 16;
+        return h;
+    }
+
+    static constexpr uint32_t of(const uint32_t seed, const i32Vec3 position) { return of(seed, position[0], position[1], position[2]); }
+
+};
@@ -0,0 +1,125 @@
+#pragma once
+
+#include "Algebra.hpp"
+#include "Block.hpp"
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+// First solid block along a ray, by voxel traversal (Amanatides and Woo) over a grid of chunks.
+// Chunks come from the caller, so the traversal does not depend on how they are stored:
+//   bool look_up(const i32Vec3 chunk_position, const Block * & blocks)
+// returns false for unknown chunks, the ray stops there without a hit. blocks are in
+// position_to_index() order, nullptr for chunks known to be empty, which are crossed in one step.
+// look_up is called once each time the ray enters a chunk.
+
+//==============================================================================
+class Raycast
+{
+public:
+    struct Ray { i32Vec3 base; f32Vec3 origin, direction; float max_distance; }; // origin is relative to base, direction does not need to be normalized
+    struct Hit { bool hit; i32Vec3 block, normal; float distance; Block type; }; // normal of the face entered, 0 if the ray starts inside
+
+    template<typename LookUp>
+    static Hit cast(const Ray & ray, const i32Vec3 chunk_sizes, LookUp && look_up);
+
+};
+
+//==============================================================================
+template<typename LookUp>
+Raycast::Hit Raycast::cast(const Ray & ray, const i32Vec3 chunk_sizes, LookUp && look_up)
+{
+    Hit result{ false, i32Vec3{ 0, 0, 0 }, i32Vec3{ 0, 0, 0 }, 0.0f, Block{} };
+
+    const auto length = std::sqrt(dot(ray.direction, ray.direction));
+    assert(length > 0.0f && "Ray without direction.");
+    const auto direction = ray.direction / length;
+    const auto infinity = std::numeric_limits<float>::infinity();
+
+    // t_max is where the ray leaves the current block on each axis, t_delta is the width of a block along the ray
+    i32Vec3 block, step, normal{ 0, 0, 0 };
+    f32Vec3 t_max, t_delta;
+
+    const auto leave = [&](const int axis, const int coordinate)
+    {
+        return step[axis] == 0 ? infinity : (static_cast<float>(coordinate - ray.base[axis] + (step[axis] > 0 ? 1 : 0)) - ray.origin[axis]) / direction[axis];
+    };
+
+    for (int i = 0; i < 3; ++i)
+    {
+        block[i] = ray.base[i] + static_cast<int>(std::floor(ray.origin[i]));
+        step[i] = direction[i] > 0.0f ? 1 : direction[i] < 0.0f ? -1 : 0;
+        t_delta[i] = step[i] == 0 ? infinity : std::abs(1.0f / direction[i]);
+        t_max[i] = leave(i, block[i]);
+    }
+
+    i32Vec3 chunk_position{ 0, 0, 0 };
+    const Block * blocks = nullptr;
+    bool entered = false;
+    float t = 0.0f;
+
+    while (t <= ray.max_distance)
+    {
+        const auto current_chunk = floor_div(block, chunk_sizes);
+
+        if (!entered || !all(chunk_position == current_chunk))
+        {
+            chunk_position = current_chunk;
+            entered = true;
+
+            if (!look_up(chunk_position, blocks))
+                return result;
+        }
+
+        int axis;
+
+        if (blocks == nullptr)
+        {
+            // jump to the block where the ray leaves the chunk
+            const auto chunk_from = chunk_position * chunk_sizes;
+            const auto chunk_to = chunk_from + chunk_sizes;
+
+            float t_exit = infinity;
+            axis = 0;
+
+            for (int i = 0; i < 3; ++i)
+            {
+                const auto t_i = leave(i, step[i] > 0 ? chunk_to[i] - 1 : chunk_from[i]);
+                if (t_i < t_exit) { t_exit = t_i; axis = i; }
+            }
+
+            t = t_exit;
+
+            for (int i = 0; i < 3; ++i)
+            {
+                if (i == axis)
+                    block[i] = step[i] > 0 ? chunk_to[i] : chunk_from[i] - 1;
+                else
+                    block[i] = std::max(chunk_from[i], std::min(chunk_to[i] - 1, ray.base[i] + static_cast<int>(std::floor(ray.origin[i] + direction[i] * t))));
+
+                t_max[i] = leave(i, block[i]);
+            }
+        }
+        else
+        {
+            const auto type = blocks[position_to_index(block, chunk_sizes)];
+
+            if (!type.isEmpty())
+            {
+                result = { true, block, normal, t, type };
+                return result;
+            }
+
+            axis = t_max[0] < t_max[1] ? (t_max[0] < t_max[2] ? 0 : 2) : (t_max[1] < t_max[2] ? 1 : 2);
+
+            t = t_max[axis];
+            block[axis] += step[axis];
+            t_max[axis] += t_delta[axis];
+        }
+
+        normal = i32Vec3{ 0, 0, 0 };
+        normal[axis] = -step[axis];
+    }
+
+    return result;
+}
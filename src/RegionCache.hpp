@@ -0,0 +1,205 @@
+#pragma once
+
+#include "Algebra.hpp"
+#include "Debug.hpp"
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Regions by position, bounded by a memory budget instead of a fixed slot per position.
+// A region costs sizeof(T) plus whatever memory_usage() reports for it (data it allocated).
+// When a region is acquired and the budget would be exceeded, unpinned regions are evicted
+// in CLOCK order (second chance for regions looked up since the hand last passed).
+// Acquired regions are pinned until unpin(). If everything is pinned the budget is exceeded.
+// operator [] and contains() don't lock, so they must not run at the same time as acquire() or
+// unpin(). find() may, it only holds a lock while the index changes, never during evict().
+// Evicted regions leave the index before evict() is called, so it may wait for their users.
+
+//==============================================================================
+template<typename T>
+class RegionCache
+{
+public:
+    using MemoryUsage = std::function<std::size_t(const T &)>;
+
+    RegionCache(const std::size_t budget, MemoryUsage memory_usage) : m_budget{ budget }, m_memory_usage{ std::move(memory_usage) } {}
+
+    RegionCache(const RegionCache &) = delete;
+    RegionCache & operator = (const RegionCache &) = delete;
+
+    bool contains(const i32Vec3 position) const { return m_index.find(keyOf(position)) != m_index.end(); }
+
+    T & operator [] (const i32Vec3 position) { return *slot(position).value; }
+    const T & operator [] (const i32Vec3 position) const { return *slot(position).value; }
+
+    // calls function(T &) if the region is in the cache. it must not block, the index is locked meanwhile
+    template<typename Function>
+    bool find(const i32Vec3 position, Function function)
+    {
+        std::unique_lock<std::mutex> lock{ m_index_lock };
+        const auto found = m_index.find(keyOf(position));
+
+        if (found == m_index.end())
+            return false;
+
+        function(*found->second->value);
+
+        return true;
+    }
+
+    // loaded is false if the region was not in the cache, the caller has to fill it
+    // evict(T &) is called for every region that is removed to make room
+    template<typename Evict>
+    T & acquire(const i32Vec3 position, bool & loaded, Evict evict)
+    {
+        const auto key = keyOf(position);
+        const auto found = m_index.find(key);
+
+        if (found != m_index.end())
+        {
+            ++found->second->pins;
+            found->second->referenced.store(true, std::memory_order_relaxed);
+            loaded = true;
+            return *found->second->value;
+        }
+
+        loaded = false;
+
+        while (memoryUsage() + sizeof(T) > m_budget)
+        {
+            if (!evictOne(evict))
+            {
+                if (!m_warned_full) Debug::print("Region cache: all regions are in use, exceeding the memory budget.");
+                m_warned_full = true;
+                break;
+            }
+        }
+
+        Slot * free_slot = nullptr;
+
+        for (auto & s : m_slots)
+            if (s->value == nullptr)
+            {
+                free_slot = s.get();
+                break;
+            }
+
+        if (free_slot == nullptr)
+        {
+            m_slots.push_back(std::make_unique<Slot>());
+            free_slot = m_slots.back().get();
+        }
+
+        std::unique_lock<std::mutex> lock{ m_index_lock };
+        free_slot->value = std::make_unique<T>();
+        free_slot->position = position;
+        free_slot->pins = 1;
+        free_slot->referenced.store(true, std::memory_order_relaxed);
+        m_index[key] = free_slot;
+
+        return *free_slot->value;
+    }
+
+    void unpin(const i32Vec3 position)
+    {
+        auto & s = slot(position);
+        assert(s.pins > 0 && "Region is not pinned.");
+        --s.pins;
+    }
+
+    template<typename Function>
+    void forEach(Function function)
+    {
+        for (auto & s : m_slots)
+            if (s->value != nullptr)
+                function(*s->value);
+    }
+
+    std::size_t memoryUsage() const
+    {
+        std::size_t usage = 0;
+
+        for (const auto & s : m_slots)
+            if (s->value != nullptr)
+                usage += sizeof(T) + m_memory_usage(*s->value);
+
+        return usage;
+    }
+
+    std::size_t size() const { return m_index.size(); }
+    std::size_t budget() const { return m_budget; }
+
+private:
+    struct Slot
+    {
+        std::unique_ptr<T> value; // nullptr if unused
+        i32Vec3 position;
+        int pins{ 0 };
+        std::atomic<bool> referenced{ false };
+    };
+
+    static uint64_t keyOf(const i32Vec3 position)
+    {
+        const auto bits = [](const int32_t v) { return static_cast<uint64_t>(static_cast<uint32_t>(v) & 0x1FFFFF); };
+        return bits(position[0]) | bits(position[1]) << 21 | bits(position[2]) << 42;
+    }
+
+    Slot & slot(const i32Vec3 position) const
+    {
+        const auto found = m_index.find(keyOf(position));
+        assert(found != m_index.end() && "Region is not loaded.");
+
+        // avoid writing the shared cache line on every lookup
+        if (!found->second->referenced.load(std::memory_order_relaxed))
+            found->second->referenced.store(true, std::memory_order_relaxed);
+
+        return *found->second;
+    }
+
+    template<typename Evict>
+    bool evictOne(Evict & evict)
+    {
+        const auto count = m_slots.size();
+
+        // two rounds: the first one may only clear reference bits
+        for (std::size_t step = 0; step < count * 2; ++step)
+        {
+            auto & s = *m_slots[m_hand];
+            m_hand = (m_hand + 1) % count;
+
+            if (s.value == nullptr || s.pins > 0)
+                continue;
+
+            if (s.referenced.exchange(false, std::memory_order_relaxed))
+                continue;
+
+            std::unique_ptr<T> evicted;
+
+            {
+                std::unique_lock<std::mutex> lock{ m_index_lock };
+                m_index.erase(keyOf(s.position));
+                evicted = std::move(s.value);
+            }
+
+            evict(*evicted);
+
+            return true;
+        }
+
+        return false;
+    }
+
+    const std::size_t m_budget;
+    const MemoryUsage m_memory_usage;
+    std::vector<std::unique_ptr<Slot>> m_slots;
+    std::unordered_map<uint64_t, Slot *> m_index;
+    std::mutex m_index_lock; // m_index and Slot::value change under it, for find()
+    std::size_t m_hand{ 0 };
+    bool m_warned_full{ false };
+
+};
@@ -0,0 +1,644 @@
+#include "RegionFile.hpp"
+#include "AsyncIO.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/user.h>
+
+//==============================================================================
+constexpr int RegionFile::SECTOR_SIZE;
+constexpr uint32_t RegionFile::MAGIC;
+constexpr uint32_t RegionFile::VERSION;
+constexpr std::size_t RegionFile::MAX_FILE_SIZE;
+constexpr int RegionFile::GROWTH_SECTORS;
+constexpr int RegionFile::COMPACTION_FREE_PERCENT;
+constexpr std::size_t RegionFile::PREFETCH_READ_SIZE;
+constexpr int RegionFile::TAG_SHIFT;
+constexpr uint32_t RegionFile::SIZE_MASK;
+
+static_assert(PAGE_SIZE % RegionFile::SECTOR_SIZE == 0, "Sectors must not cross pages.");
+
+//==============================================================================
+static std::size_t roundToPage(const std::size_t size)
+{
+    return (size + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE;
+}
+
+//==============================================================================
+RegionFile::~RegionFile()
+{
+    close();
+}
+
+//==============================================================================
+RegionFile::Format RegionFile::detect(const std::string & file_name, std::size_t * user_header_size)
+{
+    const auto file = ::open(file_name.c_str(), O_RDONLY);
+
+    if (file == -1)
+        return Format::MISSING;
+
+    FileHeader header;
+    const auto read = ::pread(file, &header, sizeof(header), 0);
+    ::close(file);
+
+    if (read == sizeof(header) && header.magic == MAGIC && header.version == VERSION && header.sector_size == SECTOR_SIZE)
+    {
+        if (user_header_size != nullptr)
+            *user_header_size = header.user_header_size;
+
+        return Format::SECTORS;
+    }
+    else
+        return Format::UNKNOWN;
+}
+
+//==============================================================================
+namespace
+{
+    struct Prefetch
+    {
+        int file;
+        std::size_t size, offset;
+        std::unique_ptr<char[]> buffer;
+
+        ~Prefetch() { ::close(file); }
+    };
+}
+
+//==============================================================================
+static void prefetchNext(AsyncIO & io, const std::shared_ptr<Prefetch> & prefetch, const std::size_t read_size)
+{
+    // one read in flight per file, the data itself is thrown away (it stays in the page cache)
+    io.read(prefetch->file, prefetch->buffer.get(), read_size, static_cast<off_t>(prefetch->offset), [&io, prefetch, read_size](const ssize_t result)
+    {
+        if (result <= 0)
+            return;
+
+        prefetch->offset += static_cast<std::size_t>(result);
+
+        if (prefetch->offset < prefetch->size)
+            prefetchNext(io, prefetch, std::min(read_size, prefetch->size - prefetch->offset));
+    });
+}
+
+//==============================================================================
+void RegionFile::prefetch(AsyncIO & io, const std::string & file_name)
+{
+    // even opening the file can wait for the drive, so do everything on the IO threads
+    io.run([&io, file_name]
+    {
+        const auto file = ::open(file_name.c_str(), O_RDONLY);
+
+        if (file == -1)
+            return;
+
+        struct stat file_stat;
+        if (::fstat(file, &file_stat) != 0 || file_stat.st_size <= 0)
+        {
+            ::close(file);
+            return;
+        }
+
+        auto prefetch = std::make_shared<Prefetch>();
+        prefetch->file = file;
+        prefetch->size = static_cast<std::size_t>(file_stat.st_size);
+        prefetch->offset = 0;
+        prefetch->buffer = std::make_unique<char[]>(PREFETCH_READ_SIZE);
+
+        prefetchNext(io, prefetch, std::min(PREFETCH_READ_SIZE, prefetch->size));
+    });
+}
+
+//==============================================================================
+void RegionFile::swap(RegionFile & other)
+{
+    std::swap(m_file, other.m_file);
+    std::swap(m_file_name, other.m_file_name);
+    std::swap(m_base, other.m_base);
+    std::swap(m_mapped_size, other.m_mapped_size);
+    std::swap(m_chunk_count, other.m_chunk_count);
+    std::swap(m_user_header_size, other.m_user_header_size);
+    std::swap(m_header_sectors, other.m_header_sectors);
+    std::swap(m_total_sectors, other.m_total_sectors);
+    std::swap(m_used_sectors, other.m_used_sectors);
+    std::swap(m_free, other.m_free);
+    std::swap(m_staged, other.m_staged);
+    std::swap(m_retired, other.m_retired);
+}
+
+//==============================================================================
+int RegionFile::headerSectors(const int chunk_count, const std::size_t user_header_size)
+{
+    return sectorsFor(static_cast<int>(sizeof(FileHeader) + sizeof(TableEntry) * chunk_count + user_header_size));
+}
+
+//==============================================================================
+bool RegionFile::open(const std::string & file_name, const int chunk_count, const std::size_t user_header_size)
+{
+    assert(!isOpen() && "Close previous file first.");
+
+    m_file = ::open(file_name.c_str(), O_RDWR);
+
+    if (m_file == -1)
+        return false;
+
+    m_file_name = file_name;
+
+    map();
+
+    const auto & header = *reinterpret_cast<const FileHeader *>(m_base);
+
+    if (header.magic != MAGIC || header.version != VERSION || header.sector_size != SECTOR_SIZE ||
+        header.chunk_count != static_cast<uint32_t>(chunk_count) || header.user_header_size != user_header_size ||
+        header.header_sectors != static_cast<uint32_t>(headerSectors(chunk_count, user_header_size)))
+        throw std::runtime_error("Region file " + file_name + " has an unexpected format.");
+
+    m_chunk_count = chunk_count;
+    m_user_header_size = user_header_size;
+    m_header_sectors = static_cast<int>(header.header_sectors);
+    m_total_sectors = static_cast<int>(m_mapped_size / SECTOR_SIZE) - m_header_sectors;
+
+    if (m_total_sectors < 0)
+        throw std::runtime_error("Region file " + file_name + " is truncated.");
+
+    rebuildFreeSectors();
+
+    return true;
+}
+
+//==============================================================================
+void RegionFile::create(const std::string & file_name, const int chunk_count, const std::size_t user_header_size)
+{
+    assert(!isOpen() && "Close previous file first.");
+
+    m_file = ::open(file_name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+    if (m_file == -1)
+        throw std::runtime_error("Creating region file " + file_name + " failed.");
+
+    m_file_name = file_name;
+
+    m_chunk_count = chunk_count;
+    m_user_header_size = user_header_size;
+    m_header_sectors = headerSectors(chunk_count, user_header_size);
+    m_total_sectors = 0;
+
+    // new file is all zeros => empty table and empty user header
+    if (::ftruncate(m_file, static_cast<off_t>(m_header_sectors) * SECTOR_SIZE) != 0)
+        throw std::runtime_error("Resizing region file " + file_name + " failed.");
+
+    map();
+
+    auto & header = *reinterpret_cast<FileHeader *>(m_base);
+    header = { MAGIC, VERSION, SECTOR_SIZE, static_cast<uint32_t>(chunk_count), static_cast<uint32_t>(user_header_size), static_cast<uint32_t>(m_header_sectors) };
+
+    rebuildFreeSectors();
+
+    // the file itself must survive a crash, not only its contents
+    sync();
+    syncDirectory(file_name);
+}
+
+//==============================================================================
+void RegionFile::map()
+{
+    struct stat status;
+    if (::fstat(m_file, &status) != 0)
+        throw std::runtime_error("Reading region file size failed.");
+
+    m_mapped_size = static_cast<std::size_t>(status.st_size);
+
+    if (m_mapped_size < sizeof(FileHeader) || m_mapped_size > MAX_FILE_SIZE || m_mapped_size % SECTOR_SIZE != 0)
+        throw std::runtime_error("Invalid region file size.");
+
+    // reserve address space for the largest possible file, so growing never moves the mapping
+    void * reserved = ::mmap(nullptr, MAX_FILE_SIZE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (reserved == MAP_FAILED)
+        throw std::runtime_error("Reserving address space for region file failed.");
+
+    m_base = static_cast<char *>(reserved);
+
+    void * mapped = ::mmap(m_base, roundToPage(m_mapped_size), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, m_file, 0);
+    if (mapped == MAP_FAILED)
+        throw std::runtime_error("Mapping region file failed.");
+}
+
+//==============================================================================
+void RegionFile::close()
+{
+    if (!isOpen())
+        return;
+
+    ::munmap(m_base, MAX_FILE_SIZE);
+    ::close(m_file);
+
+    // uncommitted chunks are dropped, the table never pointed to them
+    m_staged.clear();
+    m_retired.clear();
+
+    m_file = -1;
+    m_file_name.clear();
+    m_base = nullptr;
+    m_mapped_size = 0;
+    m_chunk_count = 0;
+    m_user_header_size = 0;
+    m_header_sectors = 0;
+    m_total_sectors = 0;
+    m_used_sectors = 0;
+    m_free.clear();
+}
+
+//==============================================================================
+void RegionFile::readUserHeader(void * destination, const std::size_t offset, const std::size_t size) const
+{
+    assert(isOpen() && offset + size <= m_user_header_size && "Out of bounds header access.");
+    std::memcpy(destination, reinterpret_cast<const char *>(table() + m_chunk_count) + offset, size);
+}
+
+//==============================================================================
+void RegionFile::writeUserHeader(const void * source, const std::size_t offset, const std::size_t size)
+{
+    assert(isOpen() && offset + size <= m_user_header_size && "Out of bounds header access.");
+    std::memcpy(reinterpret_cast<char *>(table() + m_chunk_count) + offset, source, size);
+}
+
+//==============================================================================
+int RegionFile::chunkSize(const int index) const
+{
+    assert(isOpen() && index >= 0 && index < m_chunk_count && "Out of bounds chunk access.");
+    return entrySize(table()[index]);
+}
+
+//==============================================================================
+int RegionFile::chunkTag(const int index) const
+{
+    assert(isOpen() && index >= 0 && index < m_chunk_count && "Out of bounds chunk access.");
+    return static_cast<int>(table()[index].size >> TAG_SHIFT);
+}
+
+//==============================================================================
+const char * RegionFile::chunk(const int index) const
+{
+    assert(isOpen() && index >= 0 && index < m_chunk_count && "Out of bounds chunk access.");
+    assert(table()[index].sector != 0 && "Chunk is not present.");
+    return sector(table()[index].sector);
+}
+
+//==============================================================================
+void RegionFile::writeChunk(const int index, const void * data, const int size, const int tag)
+{
+    assert(isOpen() && index >= 0 && index < m_chunk_count && size > 0 && "Invalid chunk write.");
+    assert(static_cast<uint32_t>(size) <= SIZE_MASK && tag >= 0 && tag < 256 && "Chunk size or tag out of range.");
+
+    auto & entry = table()[index];
+    const auto needed = sectorsFor(size);
+
+    // reuse old sectors if the chunk still fits in them
+    if (entry.sector == 0 || sectorsFor(entrySize(entry)) < needed)
+    {
+        eraseChunk(index);
+        entry.sector = allocateSectors(needed);
+    }
+    else
+    {
+        // release the tail if the chunk shrunk
+        const auto old_count = sectorsFor(entrySize(entry));
+        markSectors(entry.sector + needed, old_count - needed, true);
+    }
+
+    std::memcpy(sector(entry.sector), data, static_cast<std::size_t>(size));
+    entry.size = static_cast<uint32_t>(size) | static_cast<uint32_t>(tag) << TAG_SHIFT;
+}
+
+//==============================================================================
+void RegionFile::stageChunk(const int index, const void * data, const int size, const int tag)
+{
+    assert(isOpen() && index >= 0 && index < m_chunk_count && size > 0 && "Invalid chunk write.");
+    assert(static_cast<uint32_t>(size) <= SIZE_MASK && tag >= 0 && tag < 256 && "Chunk size or tag out of range.");
+
+    // never overwrite sectors in use, the old chunk must stay intact until the new one is committed
+    const auto first = allocateSectors(sectorsFor(size));
+    std::memcpy(sector(first), data, static_cast<std::size_t>(size));
+
+    const TableEntry entry{ first, static_cast<uint32_t>(size) | static_cast<uint32_t>(tag) << TAG_SHIFT };
+
+    for (auto & staged : m_staged)
+        if (staged.index == index)
+        {
+            markSectors(staged.entry.sector, sectorsFor(entrySize(staged.entry)), true);
+            staged.entry = entry;
+            return;
+        }
+
+    m_staged.push_back({ index, entry });
+}
+
+//==============================================================================
+void RegionFile::commit()
+{
+    assert(isOpen() && "No file to commit to.");
+
+    // data first, so a table entry never points to sectors that did not make it to the drive
+    try
+    {
+        sync();
+    }
+    catch (const std::runtime_error &)
+    {
+        // nothing was published, the caller stages the chunks again when it retries
+        discardStaged();
+        throw;
+    }
+
+    publish();
+    sync();
+    releaseRetired();
+}
+
+//==============================================================================
+void RegionFile::publish()
+{
+    assert(isOpen() && "No file to publish to.");
+
+    for (const auto & staged : m_staged)
+    {
+        auto & entry = table()[staged.index];
+
+        if (entry.sector != 0)
+            m_retired.push_back(entry);
+
+        entry = staged.entry;
+    }
+
+    m_staged.clear();
+}
+
+//==============================================================================
+void RegionFile::releaseRetired()
+{
+    for (const auto & entry : m_retired)
+        markSectors(entry.sector, sectorsFor(entrySize(entry)), true);
+
+    m_retired.clear();
+}
+
+//==============================================================================
+void RegionFile::discardStaged()
+{
+    for (const auto & staged : m_staged)
+        markSectors(staged.entry.sector, sectorsFor(entrySize(staged.entry)), true);
+
+    m_staged.clear();
+}
+
+//==============================================================================
+void RegionFile::sync()
+{
+    assert(isOpen() && "No file to sync.");
+
+    if (::msync(m_base, roundToPage(m_mapped_size), MS_SYNC) != 0 || ::fdatasync(m_file) != 0)
+        throw std::runtime_error("Syncing region file " + m_file_name + " failed.");
+}
+
+//==============================================================================
+void RegionFile::syncDirectory(const std::string & file_name)
+{
+    const auto slash = file_name.find_last_of('/');
+    const auto directory = slash == std::string::npos ? std::string{ "." } : file_name.substr(0, slash + 1);
+
+    const auto file = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+
+    if (file == -1)
+        throw std::runtime_error("Opening directory of " + file_name + " failed.");
+
+    const auto result = ::fsync(file);
+    ::close(file);
+
+    if (result != 0)
+        throw std::runtime_error("Syncing directory of " + file_name + " failed.");
+}
+
+//==============================================================================
+void RegionFile::eraseChunk(const int index)
+{
+    auto & entry = table()[index];
+
+    if (entry.sector == 0)
+        return;
+
+    markSectors(entry.sector, sectorsFor(entrySize(entry)), true);
+    entry = { 0, 0 };
+}
+
+//==============================================================================
+void RegionFile::rebuildFreeSectors()
+{
+    m_free.assign(static_cast<std::size_t>((m_total_sectors + 63) / 64), ~uint64_t{ 0 });
+    m_used_sectors = 0;
+
+    for (int i = 0; i < m_chunk_count; ++i)
+    {
+        const auto & entry = table()[i];
+
+        if (entry.sector == 0)
+            continue;
+
+        const auto count = sectorsFor(entrySize(entry));
+
+        if (entry.sector < static_cast<uint32_t>(m_header_sectors) || entry.sector + count > static_cast<uint32_t>(m_header_sectors + m_total_sectors))
+            throw std::runtime_error("Region file chunk table is corrupted.");
+
+        markSectors(entry.sector, count, false);
+    }
+}
+
+//==============================================================================
+void RegionFile::markSectors(const uint32_t first, const int count, const bool free)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        const auto data_sector = first + i - m_header_sectors;
+        auto & word = m_free[data_sector / 64];
+        const auto bit = uint64_t{ 1 } << (data_sector % 64);
+
+        assert(static_cast<bool>(word & bit) != free && "Sector is marked twice.");
+
+        if (free)
+            word |= bit;
+        else
+            word &= ~bit;
+    }
+
+    m_used_sectors += free ? -count : count;
+}
+
+//==============================================================================
+uint32_t RegionFile::allocateSectors(const int count)
+{
+    // first fit
+    int run = 0;
+
+    for (int i = 0; i < m_total_sectors; ++i)
+    {
+        // skip full words quickly
+        if (run == 0 && i % 64 == 0 && m_free[i / 64] == 0)
+        {
+            i += 63;
+            continue;
+        }
+
+        if (m_free[i / 64] & (uint64_t{ 1 } << (i % 64)))
+        {
+            if (++run == count)
+            {
+                const auto first = static_cast<uint32_t>(m_header_sectors + i - count + 1);
+                markSectors(first, count, false);
+                return first;
+            }
+        }
+        else
+        {
+            run = 0;
+        }
+    }
+
+    // extend file, the free run at the end (if any) is reused
+    const auto first = m_header_sectors + m_total_sectors - run;
+    resize(m_total_sectors - run + count + GROWTH_SECTORS);
+    markSectors(static_cast<uint32_t>(first), count, false);
+
+    return static_cast<uint32_t>(first);
+}
+
+//==============================================================================
+void RegionFile::resize(const int total_sectors)
+{
+    const auto new_size = static_cast<std::size_t>(m_header_sectors + total_sectors) * SECTOR_SIZE;
+
+    if (new_size > MAX_FILE_SIZE)
+        throw std::runtime_error("Region file too big.");
+
+    if (::ftruncate(m_file, static_cast<off_t>(new_size)) != 0)
+        throw std::runtime_error("Resizing region file failed.");
+
+    // only map the new pages. the old ones (and pointers to them) stay untouched
+    const auto old_mapped = roundToPage(m_mapped_size);
+    if (new_size > old_mapped)
+    {
+        void * mapped = ::mmap(m_base + old_mapped, roundToPage(new_size) - old_mapped, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, m_file, static_cast<off_t>(old_mapped));
+        if (mapped == MAP_FAILED)
+            throw std::runtime_error("Mapping region file failed.");
+    }
+
+    m_mapped_size = new_size;
+
+    const auto old_total = m_total_sectors;
+    m_total_sectors = total_sectors;
+    m_free.resize(static_cast<std::size_t>((m_total_sectors + 63) / 64), 0);
+
+    // new sectors are free
+    for (int i = old_total; i < m_total_sectors; ++i)
+        m_free[i / 64] |= uint64_t{ 1 } << (i % 64);
+}
+
+//==============================================================================
+bool RegionFile::needsCompaction() const
+{
+    const auto free_sectors = m_total_sectors - m_used_sectors;
+    return free_sectors > GROWTH_SECTORS && free_sectors * 100 > m_total_sectors * COMPACTION_FREE_PERCENT;
+}
+
+//==============================================================================
+void RegionFile::compact()
+{
+    assert(isOpen() && m_staged.empty() && m_retired.empty() && "No file to compact or uncommitted chunks.");
+
+    // the compacted copy replaces the file only when it is complete, a crash leaves either one intact
+    const auto file_name = m_file_name;
+    const auto temporary_name = file_name + ".tmp";
+
+    const auto file = ::open(temporary_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (file == -1)
+        throw std::runtime_error("Creating " + temporary_name + " failed.");
+
+    const auto write = [&](const void * data, const std::size_t size, const std::size_t offset)
+    {
+        std::size_t done = 0;
+
+        while (done < size)
+        {
+            const auto result = ::pwrite(file, static_cast<const char *>(data) + done, size - done, static_cast<off_t>(offset + done));
+
+            if (result < 0 && errno == EINTR)
+                continue;
+
+            if (result <= 0)
+            {
+                ::close(file);
+                throw std::runtime_error("Writing " + temporary_name + " failed.");
+            }
+
+            done += static_cast<std::size_t>(result);
+        }
+    };
+
+    // header, table and user header are copied, the table then gets the new positions
+    std::vector<char> header(sector(0), sector(static_cast<uint32_t>(m_header_sectors)));
+    auto * entries = reinterpret_cast<TableEntry *>(header.data() + sizeof(FileHeader));
+
+    auto next = static_cast<uint32_t>(m_header_sectors);
+
+    for (int i = 0; i < m_chunk_count; ++i)
+    {
+        const auto & entry = table()[i];
+
+        if (entry.sector == 0)
+            continue;
+
+        const auto count = sectorsFor(entrySize(entry));
+        write(sector(entry.sector), static_cast<std::size_t>(count) * SECTOR_SIZE, static_cast<std::size_t>(next) * SECTOR_SIZE);
+
+        entries[i].sector = next;
+        next += count;
+    }
+
+    write(header.data(), header.size(), 0);
+
+    if (::ftruncate(file, static_cast<off_t>(next) * SECTOR_SIZE) != 0 || ::fdatasync(file) != 0)
+    {
+        ::close(file);
+        throw std::runtime_error("Syncing " + temporary_name + " failed.");
+    }
+
+    ::close(file);
+
+    const auto chunk_count = m_chunk_count;
+    const auto user_header_size = m_user_header_size;
+
+    close();
+
+    if (::rename(temporary_name.c_str(), file_name.c_str()) != 0)
+        throw std::runtime_error("Replacing " + file_name + " failed.");
+
+    syncDirectory(file_name);
+
+    if (!open(file_name, chunk_count, user_header_size))
+        throw std::runtime_error("Reopening " + file_name + " failed.");
+}
+
+//==============================================================================
+void RegionFile::compact(const std::string & file_name, const int chunk_count, const std::size_t user_header_size)
+{
+    RegionFile file;
+
+    if (file.open(file_name, chunk_count, user_header_size))
+        file.compact();
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class AsyncIO;
+
+// Memory mapped, sector based region file.
+// Layout: [file header][chunk table][user header] padded to sectors, followed by data sectors.
+// Every chunk occupies a run of consecutive sectors. The chunk table stores
+// first sector and size in bytes. Free sectors are tracked in a bitmap that is
+// rebuilt from the chunk table when opening the file.
+// Rewriting a chunk only writes its sectors and one table entry. Chunk data
+// is read in place from the mapping. The mapping lives in a reserved address
+// range, so growing the file never moves it (compacting does move chunks).
+// Staged chunks are crash consistent: they are written to free sectors and commit()
+// publishes their table entries only after the data reached the drive. Compacting
+// writes a new file and renames it over the old one.
+// Warning: not thread safe, except for reading chunks while nothing is written.
+// Staging and syncing may run while other threads read chunks. publish() changes the table, so
+// it must not run during a chunk lookup. The sectors it replaces are not reused until
+// releaseRetired(), so chunk pointers taken before publish() stay valid until then.
+
+//==============================================================================
+class RegionFile
+{
+public:
+    enum class Format { MISSING, SECTORS, UNKNOWN };
+
+    RegionFile() {}
+    ~RegionFile();
+
+    RegionFile(const RegionFile &) = delete;
+    RegionFile & operator = (const RegionFile &) = delete;
+    RegionFile(RegionFile && other) { swap(other); }
+    RegionFile & operator = (RegionFile && other) { close(); swap(other); return *this; }
+
+    static Format detect(const std::string & file_name, std::size_t * user_header_size = nullptr); // user header size only for SECTORS
+
+    // reads the whole file asynchronously, so that mapping it later does not wait for the drive
+    static void prefetch(AsyncIO & io, const std::string & file_name);
+
+    bool open(const std::string & file_name, const int chunk_count, const std::size_t user_header_size); // returns false if file does not exist
+    void create(const std::string & file_name, const int chunk_count, const std::size_t user_header_size);
+    void close();
+
+    bool isOpen() const { return m_file != -1; }
+
+    void readUserHeader(void * destination, const std::size_t offset, const std::size_t size) const;
+    void writeUserHeader(const void * source, const std::size_t offset, const std::size_t size);
+
+    int chunkSize(const int index) const; // 0 if chunk is not present
+    int chunkTag(const int index) const; // user defined byte stored with the chunk
+    const char * chunk(const int index) const; // valid until next write or compaction
+    void writeChunk(const int index, const void * data, const int size, const int tag = 0);
+    void eraseChunk(const int index);
+
+    void stageChunk(const int index, const void * data, const int size, const int tag = 0); // visible after commit() or publish()
+    void commit(); // syncs staged data, publishes the table entries, syncs again. drops the staged chunks if syncing them fails
+    void discardStaged(); // frees the sectors of chunks that were staged but not committed
+
+    // commit() in steps, for files that are read meanwhile: sync(), publish(), sync(), releaseRetired()
+    void publish(); // makes staged chunks visible, the sectors they replace are retired
+    void releaseRetired(); // once nobody reads replaced chunks anymore and the new table is on the drive
+    void sync(); // everything written so far is on the drive when this returns
+
+    // moves all chunks to the front and shrinks the file
+    void compact();
+    bool needsCompaction() const; // too many free sectors
+    static void compact(const std::string & file_name, const int chunk_count, const std::size_t user_header_size);
+
+    int usedSectors() const { return m_used_sectors; }
+    int totalSectors() const { return m_total_sectors; }
+
+    static constexpr int SECTOR_SIZE{ 256 };
+
+private:
+    struct FileHeader { uint32_t magic, version, sector_size, chunk_count, user_header_size, header_sectors; };
+    struct TableEntry { uint32_t sector, size; }; // sector 0 == not present (header is always in sector 0), tag in the top byte of size
+    struct StagedChunk { int index; TableEntry entry; };
+
+    static constexpr uint32_t MAGIC{ 0x47525856 }; // "VXRG"
+    static constexpr uint32_t VERSION{ 1 };
+    static constexpr std::size_t MAX_FILE_SIZE{ std::size_t{ 256 } * 1024 * 1024 }; // reserved address space per file
+    static constexpr int GROWTH_SECTORS{ 1024 * 1024 / SECTOR_SIZE }; // slack preallocated per resize
+    static constexpr int COMPACTION_FREE_PERCENT{ 25 };
+    static constexpr std::size_t PREFETCH_READ_SIZE{ 1024 * 1024 };
+    static constexpr int TAG_SHIFT{ 24 };
+    static constexpr uint32_t SIZE_MASK{ (uint32_t{ 1 } << TAG_SHIFT) - 1 };
+
+    int m_file{ -1 };
+    std::string m_file_name;
+    char * m_base{ nullptr };
+    std::size_t m_mapped_size{ 0 }; // == file size
+    int m_chunk_count{ 0 };
+    std::size_t m_user_header_size{ 0 };
+    int m_header_sectors{ 0 };
+    int m_total_sectors{ 0 }; // data sectors in file (including the free ones)
+    int m_used_sectors{ 0 };
+    std::vector<uint64_t> m_free; // bit set == free data sector
+    std::vector<StagedChunk> m_staged;
+    std::vector<TableEntry> m_retired; // replaced by publish(), still in use
+
+    TableEntry * table() { return reinterpret_cast<TableEntry *>(m_base + sizeof(FileHeader)); }
+    const TableEntry * table() const { return reinterpret_cast<const TableEntry *>(m_base + sizeof(FileHeader)); }
+    char * sector(const uint32_t index) { return m_base + static_cast<std::size_t>(index) * SECTOR_SIZE; }
+    const char * sector(const uint32_t index) const { return m_base + static_cast<std::size_t>(index) * SECTOR_SIZE; }
+
+    static int sectorsFor(const int size) { return (size + SECTOR_SIZE - 1) / SECTOR_SIZE; }
+    static int entrySize(const TableEntry & entry) { return static_cast<int>(entry.size & SIZE_MASK); }
+    static int headerSectors(const int chunk_count, const std::size_t user_header_size);
+
+    void swap(RegionFile & other);
+    void map();
+    void resize(const int total_sectors);
+    void rebuildFreeSectors();
+    void markSectors(const uint32_t first, const int count, const bool free);
+    uint32_t allocateSectors(const int count);
+    static void syncDirectory(const std::string & file_name);
+
+};
@@ -5,9 +5,39 @@
 #define REL_CHUNK
 
 #define SETTINGS_TARGET_FPS 150.0
+// simulation steps per second, independent of the frame rate. replays need the same rate
+#define SETTINGS_TICK_RATE 120.0
 #define V_SYNC true
 #define MSAA_SAMPLES 1
 
+// codec for newly stored chunks (ZLIB, NONE, RLE, LZ4 or ZSTD, the last two only if built with them)
+// compare them with chunk_codec_benchmark
+#ifdef VOXEL_LZ4
+#define WORLD_CHUNK_CODEC Codec::LZ4
+#else
+#define WORLD_CHUNK_CODEC Codec::ZLIB
+#endif
+
+// terrain seed, the same seed always generates the same world
+#define WORLD_SEED 0x5EEDu
+
+// terrain generator for new chunks (SIMPLEX_2D, SINE, FRACTAL_2D or STAGED, see Terrain.hpp)
+// chunks that are already saved keep their terrain, so changing it leaves seams in old worlds
+#define WORLD_GENERATOR WorldType::SIMPLEX_2D
+
+// memory for loaded regions in bytes. least recently used regions are saved and unloaded beyond that
+// at least the regions around the player stay loaded, even if they need more
+#define WORLD_REGION_CACHE_BUDGET (64 * 1024 * 1024)
+
+// frame time dumps written on exit (comment out to disable)
+//#define FRAME_STATISTICS_CSV "frame_statistics.csv"
+//#define FRAME_STATISTICS_JSON "frame_statistics.json"
+
+// flight recording for comparable runs (comment out to disable). playback replaces the input
+// devices and exits after the last step, both can be on to record a playback again
+//#define INPUT_RECORD "flight.vxin"
+//#define INPUT_PLAYBACK "flight.vxin"
+
 //==============================================================================
 template<int S>
 class GenericSettings
@@ -0,0 +1,209 @@
+#include "Terrain.hpp"
+#include "Noise.hpp"
+#include "TerrainPipeline.hpp"
+#include "PositionRandom.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <glm/gtc/noise.hpp>
+
+//==============================================================================
+constexpr float Terrain::SIMPLEX_2D_AMPLITUDE;
+constexpr float Terrain::SINE_AMPLITUDE;
+constexpr float Terrain::FRACTAL_2D_AMPLITUDE;
+constexpr float Terrain::FRACTAL_2D_FREQUENCY;
+constexpr int Terrain::FRACTAL_2D_OCTAVES;
+constexpr float Terrain::FRACTAL_2D_LACUNARITY;
+constexpr float Terrain::FRACTAL_2D_GAIN;
+constexpr int Terrain::MAX_COLUMNS;
+
+//==============================================================================
+void Terrain::generate(Block * destination, const i32Vec3 from_block, const i32Vec3 to_block, const WorldType world_type, const uint32_t seed)
+{
+    if (hasColumns(world_type))
+    {
+        Columns columns;
+        Terrain::columns(columns, from_block, to_block, world_type, seed);
+        generate(destination, from_block, to_block, world_type, seed, columns);
+        return;
+    }
+
+    switch(world_type)
+    {
+        case WorldType::EMPTY: empty(destination, from_block, to_block); break;
+        default: throw "Not implemented."; break;
+    }
+}
+
+//==============================================================================
+void Terrain::generate(Block * destination, const i32Vec3 from_block, const i32Vec3 to_block, const WorldType world_type, const uint32_t seed, const Columns & columns)
+{
+    switch(world_type)
+    {
+        case WorldType::SINE:
+        case WorldType::SIMPLEX_2D:
+        case WorldType::FRACTAL_2D: fillColumns(destination, from_block, to_block, columns.heights, seed); break;
+        case WorldType::STAGED: TerrainPipeline::generate(destination, from_block, to_block, seed, columns); break;
+        default: generate(destination, from_block, to_block, world_type, seed); break;
+    }
+}
+
+//==============================================================================
+bool Terrain::hasColumns(const WorldType world_type)
+{
+    switch (world_type)
+    {
+        case WorldType::SINE:
+        case WorldType::SIMPLEX_2D:
+        case WorldType::FRACTAL_2D:
+        case WorldType::STAGED: return true;
+        default: return false;
+    }
+}
+
+//==============================================================================
+void Terrain::columns(Columns & destination, const i32Vec3 from_block, const i32Vec3 to_block, const WorldType world_type, const uint32_t seed)
+{
+    assert(hasColumns(world_type) && "World type has no columns.");
+
+    const auto sizes = to_block - from_block;
+    const auto count = sizes[0] * sizes[2];
+    assert(count <= MAX_COLUMNS && "Too many columns.");
+
+    switch(world_type)
+    {
+        case WorldType::SINE: sine(destination.heights, from_block, to_block); break;
+        case WorldType::SIMPLEX_2D: simplex2D(destination.heights, from_block, to_block); break;
+        case WorldType::FRACTAL_2D: fractal2D(destination.heights, from_block, to_block, seed); break;
+        case WorldType::STAGED: TerrainPipeline::columns(destination, from_block, to_block, seed); return;
+        default: throw "Not implemented."; break;
+    }
+
+    destination.lowest = *std::min_element(destination.heights, destination.heights + count);
+    destination.highest = *std::max_element(destination.heights, destination.heights + count);
+}
+
+//==============================================================================
+bool Terrain::uniform(const i32Vec3 from_block, const i32Vec3 to_block, const WorldType world_type, Block & value)
+{
+    (void)to_block;
+
+    // everything above the highest possible surface is air
+    switch (world_type)
+    {
+        case WorldType::EMPTY: value = Block{ 0 }; return true;
+        case WorldType::SIMPLEX_2D: value = Block{ 0 }; return static_cast<float>(from_block[1]) >= SIMPLEX_2D_AMPLITUDE;
+        case WorldType::SINE: value = Block{ 0 }; return static_cast<float>(from_block[1]) >= SINE_AMPLITUDE;
+        case WorldType::FRACTAL_2D: value = Block{ 0 }; return static_cast<float>(from_block[1]) >= FRACTAL_2D_AMPLITUDE * Noise::amplitudeSum(FRACTAL_2D_OCTAVES, FRACTAL_2D_GAIN);
+        case WorldType::STAGED: value = Block{ 0 }; return static_cast<float>(from_block[1]) >= TerrainPipeline::highestBlock();
+        default: return false;
+    }
+}
+
+//==============================================================================
+void Terrain::empty(Block * destination, const i32Vec3 from_block, const i32Vec3 to_block)
+{
+    i32Vec3 position;
+    int i = 0;
+
+    for (position[2] = from_block[2]; position[2] < to_block[2]; ++position[2])
+        for (position[1] = from_block[1]; position[1] < to_block[1]; ++position[1])
+            for (position[0] = from_block[0]; position[0] < to_block[0]; ++position[0])
+                destination[i++] = Block{ 0 };
+}
+
+//==============================================================================
+void Terrain::simplex2D(float * heights, const i32Vec3 from_block, const i32Vec3 to_block)
+{
+    int i = 0;
+
+    for (int z = from_block[2]; z < to_block[2]; ++z)
+        for (int x = from_block[0]; x < to_block[0]; ++x)
+        {
+            const glm::vec2 f_position{ x, z };
+            heights[i++] = glm::simplex(f_position * 0.03f) * SIMPLEX_2D_AMPLITUDE;
+        }
+}
+
+//==============================================================================
+void Terrain::sine(float * heights, const i32Vec3 from_block, const i32Vec3 to_block)
+{
+    int i = 0;
+
+    for (int z = from_block[2]; z < to_block[2]; ++z)
+        for (int x = from_block[0]; x < to_block[0]; ++x)
+            heights[i++] = std::sin(x * 0.1f) * std::sin(z * 0.1f) * SINE_AMPLITUDE;
+}
+
+//==============================================================================
+void Terrain::fractal2D(float * heights, const i32Vec3 from_block, const i32Vec3 to_block, const uint32_t seed)
+{
+    const auto sizes = to_block - from_block;
+    const auto count = sizes[0] * sizes[2];
+    static_assert(MAX_COLUMNS <= Noise::MAX_COUNT, "Too many columns for one noise call.");
+
+    float xs[MAX_COLUMNS], zs[MAX_COLUMNS];
+    int i = 0;
+
+    for (int z = from_block[2]; z < to_block[2]; ++z)
+        for (int x = from_block[0]; x < to_block[0]; ++x)
+        {
+            xs[i] = static_cast<float>(x) * FRACTAL_2D_FREQUENCY;
+            zs[i] = static_cast<float>(z) * FRACTAL_2D_FREQUENCY;
+            ++i;
+        }
+
+    Noise::fractal2D(heights, xs, zs, count, seed, FRACTAL_2D_OCTAVES, FRACTAL_2D_LACUNARITY, FRACTAL_2D_GAIN);
+
+    for (i = 0; i < count; ++i)
+        heights[i] *= FRACTAL_2D_AMPLITUDE;
+}
+
+//==============================================================================
+void Terrain::fillColumns(Block * destination, const i32Vec3 from_block, const i32Vec3 to_block, const float * heights, const uint32_t seed)
+{
+    const auto sizes = to_block - from_block;
+    auto * row = destination;
+
+    for (int z = 0; z < sizes[2]; ++z)
+    {
+        const auto * row_heights = heights + z * sizes[0];
+        const auto highest = *std::max_element(row_heights, row_heights + sizes[0]);
+        const auto position_z = from_block[2] + z;
+
+        for (int y = 0; y < sizes[1]; ++y)
+        {
+            const auto position_y = from_block[1] + y;
+
+            // everything from here up is air
+            if (highest <= static_cast<float>(position_y))
+            {
+                const auto rest = sizes[0] * (sizes[1] - y);
+                std::fill(row, row + rest, Block{ 0 });
+                row += rest;
+                break;
+            }
+
+            // no branches and plain bytes, so this vectorizes
+            static_assert(sizeof(Block) == sizeof(signed char), "Blocks are written as their type.");
+            auto * types = reinterpret_cast<signed char *>(row);
+
+            for (int x = 0; x < sizes[0]; ++x)
+            {
+                const auto type = groundType(PositionRandom::of(seed, from_block[0] + x, position_y, position_z));
+                types[x] = row_heights[x] > static_cast<float>(position_y) ? type : 0;
+            }
+
+            row += sizes[0];
+        }
+    }
+}
+
+//==============================================================================
+signed char Terrain::groundType(const uint32_t random)
+{
+    // top bits are mixed best: 3/16 type 3, 8/16 type 2, 5/16 type 1
+    const auto value = random >> 28;
+
+    return static_cast<signed char>(value < 3 ? 3 : value < 11 ? 2 : 1);
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "Algebra.hpp"
+#include "Block.hpp"
+#include <cstdint>
+
+enum class WorldType { SINE, SMALL_BLOCK, FLOOR, SIMPLEX_2D, EMPTY, FRACTAL_2D, STAGED };
+
+// Chunk generators. Blocks are written in position_to_index() order (x fastest, then y, then z).
+// Independent of World, so tools can generate terrain without a world.
+// The result only depends on the arguments, random block types come from PositionRandom.
+// Height based terrain computes one height per column and then fills whole rows,
+// rows above the surface are cleared at once. At most MAX_COLUMNS columns per call.
+// STAGED runs TerrainPipeline, which has stricter limits on the block range.
+// The 2D part (Columns) is the same for all chunks stacked on top of each other, it can be
+// computed once with columns() and passed to generate() for every chunk of the column.
+
+//==============================================================================
+class Terrain
+{
+public:
+    static constexpr int MAX_COLUMNS{ 16 * 16 };
+
+    // per column data in x, z order, only heights for all but STAGED
+    struct Columns
+    {
+        float heights[MAX_COLUMNS];
+        float filler_depth[MAX_COLUMNS];
+        signed char surface[MAX_COLUMNS];
+        float lowest, highest;
+    };
+
+    static void generate(Block * destination, const i32Vec3 from_block, const i32Vec3 to_block, const WorldType world_type, const uint32_t seed);
+    static void generate(Block * destination, const i32Vec3 from_block, const i32Vec3 to_block, const WorldType world_type, const uint32_t seed, const Columns & columns); // columns() of the same x and z range
+    static bool uniform(const i32Vec3 from_block, const i32Vec3 to_block, const WorldType world_type, Block & value); // true if the range is known to be a single block type, without generating it
+
+    static bool hasColumns(const WorldType world_type);
+    static void columns(Columns & destination, const i32Vec3 from_block, const i32Vec3 to_block, const WorldType world_type, const uint32_t seed); // y is ignored
+
+private:
+    static constexpr float SIMPLEX_2D_AMPLITUDE{ 5.0f };
+    static constexpr float SINE_AMPLITUDE{ 10.0f };
+    static constexpr float FRACTAL_2D_AMPLITUDE{ 24.0f }; // of the first octave
+    static constexpr float FRACTAL_2D_FREQUENCY{ 0.01f };
+    static constexpr int FRACTAL_2D_OCTAVES{ 4 };
+    static constexpr float FRACTAL_2D_LACUNARITY{ 2.0f };
+    static constexpr float FRACTAL_2D_GAIN{ 0.5f };
+
+    static void empty(Block * destination, const i32Vec3 from_block, const i32Vec3 to_block);
+    static void simplex2D(float * heights, const i32Vec3 from_block, const i32Vec3 to_block);
+    static void sine(float * heights, const i32Vec3 from_block, const i32Vec3 to_block);
+    static void fractal2D(float * heights, const i32Vec3 from_block, const i32Vec3 to_block, const uint32_t seed);
+    static void fillColumns(Block * destination, const i32Vec3 from_block, const i32Vec3 to_block, const float * heights, const uint32_t seed); // blocks below the height are ground
+    static signed char groundType(const uint32_t random);
+
+};
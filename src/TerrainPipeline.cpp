@@ -0,0 +1,396 @@
+#include "TerrainPipeline.hpp"
+#include "Noise.hpp"
+#include "PositionRandom.hpp"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+
+//==============================================================================
+constexpr int TerrainPipeline::MAX_SIZE;
+constexpr int TerrainPipeline::CAVE_STEP;
+constexpr int TerrainPipeline::MAX_COLUMNS;
+constexpr int TerrainPipeline::MAX_CAVE_POINTS;
+constexpr float TerrainPipeline::HEIGHT_AMPLITUDE;
+constexpr float TerrainPipeline::HEIGHT_FREQUENCY;
+constexpr int TerrainPipeline::HEIGHT_OCTAVES;
+constexpr float TerrainPipeline::BIOME_FREQUENCY;
+constexpr float TerrainPipeline::DESERT_THRESHOLD;
+constexpr int TerrainPipeline::MAX_FILLER_DEPTH;
+constexpr float TerrainPipeline::CAVE_FREQUENCY;
+constexpr float TerrainPipeline::CAVE_SQUASH;
+constexpr float TerrainPipeline::CAVE_RADIUS;
+constexpr int TerrainPipeline::FEATURE_CELL;
+constexpr int TerrainPipeline::FEATURE_CHANCE;
+constexpr int TerrainPipeline::MAX_BOULDER_RADIUS;
+constexpr signed char TerrainPipeline::GRASS;
+constexpr signed char TerrainPipeline::SAND;
+constexpr signed char TerrainPipeline::STONE;
+
+std::atomic<long long> TerrainPipeline::s_nanoseconds[static_cast<int>(TerrainPipeline::Stage::last)];
+std::atomic<long long> TerrainPipeline::s_chunks{ 0 };
+
+using Clock = std::chrono::steady_clock;
+
+//==============================================================================
+void TerrainPipeline::columns(Terrain::Columns & destination, const i32Vec3 from_block, const i32Vec3 to_block, const uint32_t seed)
+{
+    const auto sizes = to_block - from_block;
+    const auto count = sizes[0] * sizes[2];
+    assert(count <= MAX_COLUMNS && "Too many columns.");
+
+    const auto begin = Clock::now();
+
+    float xs[MAX_COLUMNS], zs[MAX_COLUMNS];
+    int i = 0;
+
+    for (int z = from_block[2]; z < to_block[2]; ++z)
+        for (int x = from_block[0]; x < to_block[0]; ++x)
+        {
+            xs[i] = static_cast<float>(x);
+            zs[i] = static_cast<float>(z);
+            ++i;
+        }
+
+    heights(destination.heights, xs, zs, count, seed);
+
+    destination.lowest = *std::min_element(destination.heights, destination.heights + count);
+    destination.highest = *std::max_element(destination.heights, destination.heights + count);
+
+    const auto middle = Clock::now();
+    s_nanoseconds[static_cast<int>(Stage::DENSITY)] += std::chrono::duration_cast<std::chrono::nanoseconds>(middle - begin).count();
+
+    biomes(destination, from_block, to_block, seed);
+
+    s_nanoseconds[static_cast<int>(Stage::SURFACE)] += std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - middle).count();
+}
+
+//==============================================================================
+void TerrainPipeline::generate(Block * destination, const i32Vec3 from_block, const i32Vec3 to_block, const uint32_t seed, const Terrain::Columns & columns)
+{
+    const auto sizes = to_block - from_block;
+    assert(all(sizes > i32Vec3{ 0, 0, 0 }) && all(sizes <= i32Vec3{ MAX_SIZE, MAX_SIZE, MAX_SIZE }) && all(sizes % CAVE_STEP == i32Vec3{ 0, 0, 0 }) && "Unsupported block range.");
+    static_assert(MAX_COLUMNS <= Noise::MAX_COUNT && MAX_SIZE * MAX_SIZE <= MAX_COLUMNS, "Too many columns for one noise call.");
+    static_assert(sizeof(Block) == sizeof(signed char), "Blocks are written as their type.");
+
+    auto * types = reinterpret_cast<signed char *>(destination);
+
+    auto begin = Clock::now();
+    const auto lap = [&begin] (const Stage stage)
+    {
+        const auto end = Clock::now();
+        s_nanoseconds[static_cast<int>(stage)] += std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
+        begin = end;
+    };
+
+    density(types, from_block, to_block, columns);
+    lap(Stage::DENSITY);
+
+    surface(types, from_block, to_block, columns);
+    lap(Stage::SURFACE);
+
+    carve(types, from_block, to_block, seed, columns);
+    lap(Stage::CARVE);
+
+    features(types, from_block, to_block, seed);
+    lap(Stage::FEATURES);
+
+    ++s_chunks;
+}
+
+//==============================================================================
+float TerrainPipeline::highestBlock()
+{
+    return HEIGHT_AMPLITUDE * Noise::amplitudeSum(HEIGHT_OCTAVES, 0.5f) + static_cast<float>(MAX_BOULDER_RADIUS);
+}
+
+//==============================================================================
+const char * TerrainPipeline::name(const Stage stage)
+{
+    switch (stage)
+    {
+        case Stage::DENSITY: return "density";
+        case Stage::SURFACE: return "surface";
+        case Stage::CARVE: return "carve";
+        case Stage::FEATURES: return "features";
+        default: return "unknown";
+    }
+}
+
+//==============================================================================
+double TerrainPipeline::seconds(const Stage stage)
+{
+    return static_cast<double>(s_nanoseconds[static_cast<int>(stage)].load()) * 1e-9;
+}
+
+//==============================================================================
+long long TerrainPipeline::chunks()
+{
+    return s_chunks.load();
+}
+
+//==============================================================================
+void TerrainPipeline::biomes(Terrain::Columns & destination, const i32Vec3 from_block, const i32Vec3 to_block, const uint32_t seed)
+{
+    const auto sizes = to_block - from_block;
+    const auto count = sizes[0] * sizes[2];
+    assert(count <= MAX_COLUMNS && "Too many columns.");
+
+    const auto biome_seed = stageSeed(seed, Stage::SURFACE);
+    float xs[MAX_COLUMNS]{}, zs[MAX_COLUMNS]{}, biomes[MAX_COLUMNS];
+    int i = 0;
+
+    for (int z = from_block[2]; z < to_block[2]; ++z)
+        for (int x = from_block[0]; x < to_block[0]; ++x)
+        {
+            xs[i] = static_cast<float>(x) * BIOME_FREQUENCY;
+            zs[i] = static_cast<float>(z) * BIOME_FREQUENCY;
+            ++i;
+        }
+
+    Noise::simplex2D(biomes, xs, zs, count, biome_seed);
+
+    i = 0;
+    for (int z = from_block[2]; z < to_block[2]; ++z)
+        for (int x = from_block[0]; x < to_block[0]; ++x, ++i)
+        {
+            // sand goes deeper in deserts, the random part keeps the layers from looking flat
+            const bool desert = biomes[i] > DESERT_THRESHOLD;
+            const auto random = static_cast<float>(PositionRandom::of(biome_seed, x, 0, z) >> 30);
+
+            destination.surface[i] = desert ? SAND : GRASS;
+            destination.filler_depth[i] = (desert ? 4.0f : 1.0f) + random;
+        }
+}
+
+//==============================================================================
+void TerrainPipeline::density(signed char * destination, const i32Vec3 from_block, const i32Vec3 to_block, const Terrain::Columns & columns)
+{
+    const auto sizes = to_block - from_block;
+    auto * row = destination;
+
+    for (int z = 0; z < sizes[2]; ++z)
+    {
+        const auto * row_heights = columns.heights + z * sizes[0];
+
+        for (int y = 0; y < sizes[1]; ++y)
+        {
+            const auto position_y = static_cast<float>(from_block[1] + y);
+
+            for (int x = 0; x < sizes[0]; ++x)
+                row[x] = row_heights[x] > position_y ? STONE : 0;
+
+            row += sizes[0];
+        }
+    }
+}
+
+//==============================================================================
+void TerrainPipeline::surface(signed char * destination, const i32Vec3 from_block, const i32Vec3 to_block, const Terrain::Columns & columns)
+{
+    const auto sizes = to_block - from_block;
+
+    // below the lowest surface minus the deepest filler everything stays stone
+    const auto bottom = columns.lowest - static_cast<float>(1 + MAX_FILLER_DEPTH);
+    if (static_cast<float>(to_block[1]) <= bottom || static_cast<float>(from_block[1]) >= columns.highest)
+        return;
+
+    auto * row = destination;
+
+    for (int z = 0; z < sizes[2]; ++z)
+    {
+        const auto * row_heights = columns.heights + z * sizes[0];
+        const auto * row_surface = columns.surface + z * sizes[0];
+        const auto * row_filler = columns.filler_depth + z * sizes[0];
+
+        for (int y = 0; y < sizes[1]; ++y)
+        {
+            const auto position_y = static_cast<float>(from_block[1] + y);
+
+            if (position_y >= bottom)
+                for (int x = 0; x < sizes[0]; ++x)
+                {
+                    // depth of the block below the surface, the top block is in (0, 1]
+                    const auto depth = row_heights[x] - position_y;
+                    const auto type = depth <= 1.0f ? row_surface[x] : depth <= 1.0f + row_filler[x] ? SAND : STONE;
+                    row[x] = row[x] != 0 ? type : 0;
+                }
+
+            row += sizes[0];
+        }
+    }
+}
+
+//==============================================================================
+void TerrainPipeline::carve(signed char * destination, const i32Vec3 from_block, const i32Vec3 to_block, const uint32_t seed, const Terrain::Columns & columns)
+{
+    // nothing to carve in the sky
+    if (static_cast<float>(from_block[1]) >= columns.highest)
+        return;
+
+    const auto sizes = to_block - from_block;
+    const auto points = sizes / CAVE_STEP + 1;
+    const auto count = product(points);
+
+    float xs[MAX_CAVE_POINTS], ys[MAX_CAVE_POINTS], zs[MAX_CAVE_POINTS];
+    float first[MAX_CAVE_POINTS], second[MAX_CAVE_POINTS];
+    int i = 0;
+
+    for (int z = 0; z < points[2]; ++z)
+        for (int y = 0; y < points[1]; ++y)
+            for (int x = 0; x < points[0]; ++x)
+            {
+                xs[i] = static_cast<float>(from_block[0] + x * CAVE_STEP) * CAVE_FREQUENCY;
+                ys[i] = static_cast<float>(from_block[1] + y * CAVE_STEP) * CAVE_FREQUENCY * CAVE_SQUASH;
+                zs[i] = static_cast<float>(from_block[2] + z * CAVE_STEP) * CAVE_FREQUENCY;
+                ++i;
+            }
+
+    // a tunnel runs where both fields are close to zero, the intersection of two surfaces
+    const auto cave_seed = stageSeed(seed, Stage::CARVE);
+    Noise::simplex3D(first, xs, ys, zs, count, cave_seed);
+    Noise::simplex3D(second, xs, ys, zs, count, cave_seed + 0x9E3779B9u);
+
+    // grid cell and weight of every x, so the innermost loop is a plain lerp
+    int cell_x[MAX_SIZE];
+    float weight_x[MAX_SIZE];
+    for (int x = 0; x < sizes[0]; ++x)
+    {
+        cell_x[x] = x / CAVE_STEP;
+        weight_x[x] = static_cast<float>(x % CAVE_STEP) / static_cast<float>(CAVE_STEP);
+    }
+
+    auto * row = destination;
+
+    for (int z = 0; z < sizes[2]; ++z)
+    {
+        const auto cell_z = z / CAVE_STEP;
+        const auto weight_z = static_cast<float>(z % CAVE_STEP) / static_cast<float>(CAVE_STEP);
+
+        for (int y = 0; y < sizes[1]; ++y)
+        {
+            const auto cell_y = y / CAVE_STEP;
+            const auto weight_y = static_cast<float>(y % CAVE_STEP) / static_cast<float>(CAVE_STEP);
+
+            // both fields along the row, interpolated in y and z at every grid x
+            float first_row[MAX_SIZE / CAVE_STEP + 1], second_row[MAX_SIZE / CAVE_STEP + 1];
+
+            for (int x = 0; x < points[0]; ++x)
+            {
+                const auto a = position_to_index(i32Vec3{ x, cell_y, cell_z }, points);
+                const auto b = position_to_index(i32Vec3{ x, cell_y + 1, cell_z }, points);
+                const auto c = position_to_index(i32Vec3{ x, cell_y, cell_z + 1 }, points);
+                const auto d = position_to_index(i32Vec3{ x, cell_y + 1, cell_z + 1 }, points);
+
+                const auto first_near = first[a] + (first[b] - first[a]) * weight_y;
+                const auto first_far = first[c] + (first[d] - first[c]) * weight_y;
+                const auto second_near = second[a] + (second[b] - second[a]) * weight_y;
+                const auto second_far = second[c] + (second[d] - second[c]) * weight_y;
+
+                first_row[x] = first_near + (first_far - first_near) * weight_z;
+                second_row[x] = second_near + (second_far - second_near) * weight_z;
+            }
+
+            for (int x = 0; x < sizes[0]; ++x)
+            {
+                const auto f = first_row[cell_x[x]] + (first_row[cell_x[x] + 1] - first_row[cell_x[x]]) * weight_x[x];
+                const auto s = second_row[cell_x[x]] + (second_row[cell_x[x] + 1] - second_row[cell_x[x]]) * weight_x[x];
+                row[x] = f * f + s * s < CAVE_RADIUS * CAVE_RADIUS ? 0 : row[x];
+            }
+
+            row += sizes[0];
+        }
+    }
+}
+
+//==============================================================================
+void TerrainPipeline::features(signed char * destination, const i32Vec3 from_block, const i32Vec3 to_block, const uint32_t seed)
+{
+    static_assert((FEATURE_CELL & (FEATURE_CELL - 1)) == 0, "Cell size must be a power of 2.");
+
+    // boulders sit on the surface, which is never further from 0 than this
+    const auto reach = highestBlock();
+    if (static_cast<float>(from_block[1]) >= reach || static_cast<float>(to_block[1]) <= -reach)
+        return;
+
+    const auto sizes = to_block - from_block;
+    const auto feature_seed = stageSeed(seed, Stage::FEATURES);
+
+    // every cell with a boulder center close enough to touch this range
+    const i32Vec3 cell_sizes{ FEATURE_CELL, FEATURE_CELL, FEATURE_CELL };
+    const auto first_cell = floor_div(from_block - MAX_BOULDER_RADIUS, cell_sizes);
+    const auto last_cell = floor_div(to_block + MAX_BOULDER_RADIUS, cell_sizes);
+
+    for (int cell_z = first_cell[2]; cell_z <= last_cell[2]; ++cell_z)
+        for (int cell_x = first_cell[0]; cell_x <= last_cell[0]; ++cell_x)
+        {
+            const auto random = PositionRandom::of(feature_seed, cell_x, 0, cell_z);
+
+            if (static_cast<int>(random >> 28) >= FEATURE_CHANCE)
+                continue;
+
+            const auto center_x = cell_x * FEATURE_CELL + static_cast<int>(random & (FEATURE_CELL - 1));
+            const auto center_z = cell_z * FEATURE_CELL + static_cast<int>((random >> 8) & (FEATURE_CELL - 1));
+            const auto radius = 2 + static_cast<int>((random >> 16) % (MAX_BOULDER_RADIUS - 1));
+
+            if (center_x + radius < from_block[0] || center_x - radius >= to_block[0] ||
+                center_z + radius < from_block[2] || center_z - radius >= to_block[2])
+                continue;
+
+            // half sunk into the ground at the center column
+            const float center_xs[1]{ static_cast<float>(center_x) }, center_zs[1]{ static_cast<float>(center_z) };
+            float height[1];
+            heights(height, center_xs, center_zs, 1, seed);
+
+            const auto center_y = static_cast<int>(std::floor(height[0]));
+
+            const i32Vec3 center{ center_x, center_y, center_z };
+            const auto from = max(center - radius, from_block) - from_block;
+            const auto to = min(center + radius + 1, to_block) - from_block;
+
+            if (!all(from < to))
+                continue;
+
+            const auto radius_squared = static_cast<float>(radius * radius);
+
+            for (int z = from[2]; z < to[2]; ++z)
+                for (int y = from[1]; y < to[1]; ++y)
+                {
+                    const auto dy = static_cast<float>(from_block[1] + y - center_y) * 1.4f; // a bit flat
+                    const auto dz = static_cast<float>(from_block[2] + z - center_z);
+                    auto * row = destination + position_to_index(i32Vec3{ 0, y, z }, sizes);
+
+                    for (int x = from[0]; x < to[0]; ++x)
+                    {
+                        const auto dx = static_cast<float>(from_block[0] + x - center_x);
+                        row[x] = dx * dx + dy * dy + dz * dz <= radius_squared ? STONE : row[x];
+                    }
+                }
+        }
+}
+
+//==============================================================================
+void TerrainPipeline::heights(float * destination, const float * x, const float * z, const int count, const uint32_t seed)
+{
+    assert(count <= MAX_COLUMNS && "Too many columns.");
+
+    float xs[MAX_COLUMNS]{}, zs[MAX_COLUMNS]{};
+
+    for (int n = 0; n < count; ++n)
+    {
+        xs[n] = x[n] * HEIGHT_FREQUENCY;
+        zs[n] = z[n] * HEIGHT_FREQUENCY;
+    }
+
+    Noise::fractal2D(destination, xs, zs, count, stageSeed(seed, Stage::DENSITY), HEIGHT_OCTAVES, 2.0f, 0.5f);
+
+    for (int n = 0; n < count; ++n)
+        destination[n] *= HEIGHT_AMPLITUDE;
+}
+
+//==============================================================================
+uint32_t TerrainPipeline::stageSeed(const uint32_t seed, const Stage stage)
+{
+    // stages must not share noise, or caves would follow the hills
+    return PositionRandom::of(seed, static_cast<int32_t>(stage), 0x5EED, 0);
+}
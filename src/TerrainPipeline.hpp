@@ -0,0 +1,72 @@
+#pragma once
+
+#include "Algebra.hpp"
+#include "Block.hpp"
+#include "Terrain.hpp"
+#include <atomic>
+#include <cstdint>
+
+// Terrain generated in stages, each one pass over the whole range with branch free inner loops:
+//   DENSITY  - column heights from fractal noise, stone below, air above
+//   SURFACE  - biome per column (grass or desert), surface and filler blocks over the stone
+//   CARVE    - tunnels where two 3D noise fields are both near zero, the noise is sampled
+//              every CAVE_STEP blocks and interpolated in between
+//   FEATURES - boulders, at most one per FEATURE_CELL x FEATURE_CELL columns. Where they are only
+//              depends on the seed and the cell, so they cross chunk borders without seams
+// Same contract as Terrain: the result only depends on the arguments. The 2D part of DENSITY
+// and SURFACE is done by columns(), once per column if the caller keeps the result.
+// Time spent per stage is summed over all threads, see seconds().
+
+//==============================================================================
+class TerrainPipeline
+{
+public:
+    enum class Stage : int { DENSITY, SURFACE, CARVE, FEATURES, last };
+
+    static void columns(Terrain::Columns & destination, const i32Vec3 from_block, const i32Vec3 to_block, const uint32_t seed);
+    static void generate(Block * destination, const i32Vec3 from_block, const i32Vec3 to_block, const uint32_t seed, const Terrain::Columns & columns);
+    static float highestBlock(); // everything at and above is air
+
+    static const char * name(const Stage stage);
+    static double seconds(const Stage stage);
+    static long long chunks();
+
+    static constexpr int MAX_SIZE{ 16 }; // blocks per axis and call
+    static constexpr int CAVE_STEP{ 4 }; // sizes must be multiples of it
+
+private:
+    static constexpr int MAX_COLUMNS{ Terrain::MAX_COLUMNS };
+    static constexpr int MAX_CAVE_POINTS{ (MAX_SIZE / CAVE_STEP + 1) * (MAX_SIZE / CAVE_STEP + 1) * (MAX_SIZE / CAVE_STEP + 1) };
+
+    static constexpr float HEIGHT_AMPLITUDE{ 32.0f }; // of the first octave
+    static constexpr float HEIGHT_FREQUENCY{ 0.004f };
+    static constexpr int HEIGHT_OCTAVES{ 5 };
+
+    static constexpr float BIOME_FREQUENCY{ 0.002f };
+    static constexpr float DESERT_THRESHOLD{ 0.25f }; // biome noise above is desert
+    static constexpr int MAX_FILLER_DEPTH{ 7 };
+
+    static constexpr float CAVE_FREQUENCY{ 0.02f };
+    static constexpr float CAVE_SQUASH{ 2.0f }; // tunnels are flatter than wide
+    static constexpr float CAVE_RADIUS{ 0.12f }; // in noise units
+
+    static constexpr int FEATURE_CELL{ 32 }; // power of 2
+    static constexpr int FEATURE_CHANCE{ 6 }; // out of 16 cells
+    static constexpr int MAX_BOULDER_RADIUS{ 5 };
+
+    static constexpr signed char GRASS{ 1 }, SAND{ 2 }, STONE{ 3 };
+
+    static void biomes(Terrain::Columns & destination, const i32Vec3 from_block, const i32Vec3 to_block, const uint32_t seed);
+
+    static void density(signed char * destination, const i32Vec3 from_block, const i32Vec3 to_block, const Terrain::Columns & columns);
+    static void surface(signed char * destination, const i32Vec3 from_block, const i32Vec3 to_block, const Terrain::Columns & columns);
+    static void carve(signed char * destination, const i32Vec3 from_block, const i32Vec3 to_block, const uint32_t seed, const Terrain::Columns & columns);
+    static void features(signed char * destination, const i32Vec3 from_block, const i32Vec3 to_block, const uint32_t seed);
+
+    static void heights(float * destination, const float * x, const float * z, const int count, const uint32_t seed);
+    static uint32_t stageSeed(const uint32_t seed, const Stage stage);
+
+    static std::atomic<long long> s_nanoseconds[static_cast<int>(Stage::last)];
+    static std::atomic<long long> s_chunks;
+
+};
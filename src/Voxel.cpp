@@ -7,6 +7,9 @@
 #include "Profiler.hpp"
 #include "Keyboard.hpp"
 #include <glm/gtx/string_cast.hpp>
+#include <sstream>
+#include <algorithm>
+#include <iomanip>
 
 //==============================================================================
 static const std::vector<TextureArray::Source> BLOCK_TEXTURE_SOURCE
@@ -21,6 +24,14 @@ static const Texture::Filtering BLOCK_TEXTURE_FILTERING
         Texture::CloseFiltering::LINEAR_TEXEL, 500.0f
 };
 
+//==============================================================================
+static std::string percentilesToString(const FrameStatistics::Percentiles & p)
+{
+    std::ostringstream stream;
+    stream << std::fixed << std::setprecision(1) << p.p50 << "/" << p.p95 << "/" << p.p99 << "/" << p.max;
+    return stream.str();
+}
+
 //==============================================================================
 Voxel::Voxel(const std::string & name) :
     m_window{ Window::Hints{ 3, 1, MSAA_SAMPLES, nullptr, name, 0.9f, 0.9f, 0.6f, 1.0f, V_SYNC, 960, 540 } },
@@ -38,7 +49,17 @@ Voxel::Voxel(const std::string & name) :
                     { "shader/text.frag", GL_FRAGMENT_SHADER }
             }
     }
+#ifdef INPUT_PLAYBACK
+    , m_input_playback{ INPUT_PLAYBACK, SETTINGS_TICK_RATE }
+#endif
+#ifdef INPUT_RECORD
+    , m_input_recorder{ INPUT_RECORD, SETTINGS_TICK_RATE, m_player }
+#endif
 {
+#ifdef INPUT_PLAYBACK
+    m_input_playback.start(m_player);
+#endif
+
     m_block_shader.use();
     m_block_VP_matrix_location = glGetUniformLocation(m_block_shader.id(), "VP_matrix");
     GLint block_texture_array_location = glGetUniformLocation(m_block_shader.id(), "block_texture_array");
@@ -104,11 +125,14 @@ void Voxel::run()
 
     int frame_counter = 0;
     double last_fps_update = last_time;
+    double unsimulated_time = 0.0;
 
-    while (!m_window.exitRequested())
+    while (!m_window.exitRequested() && !m_input_done)
     {
+        m_frame_statistics.beginFrame();
+
         const double current_time = glfwGetTime();
-        double delta_time = current_time - last_time; // TODO: separate framerate from user input, introtuce fixed timestamp for user updates (except maybe head rotation)
+        const double delta_time = current_time - last_time;
         last_time = current_time;
 
         // update FPS counter
@@ -121,14 +145,20 @@ void Voxel::run()
 
 #if 1
             const auto pos = m_player.getPosition();
-            const auto int_pos = int_floor(f32Vec3{ pos.x, pos.y, pos.z });
+            const auto int_pos = m_player.getBlockPosition();
             const auto current_settings = m_settings.current();
             const auto current_settings_val = m_settings.getInt(current_settings);
+            const auto view = m_player.getViewDirection();
+            const auto pick = m_world.raycast({ m_player.getOrigin(), f32Vec3{ pos.x, pos.y, pos.z }, f32Vec3{ view.x, view.y, view.z }, PICK_DISTANCE });
             m_screen_text.update("FPS: " + std::to_string(static_cast<int>(frame_rate + 0.5)) + "\n" +
                                  std::to_string(int_pos[0]) + "|" +
                                  std::to_string(int_pos[1]) + "|" +
                                  std::to_string(int_pos[2]) + "\n" +
-                                 "Settings:" + std::to_string(current_settings) + " => " + std::to_string(current_settings_val)
+                                 (pick.hit ? "Block: " + std::to_string(pick.block[0]) + "|" +
+                                             std::to_string(pick.block[1]) + "|" +
+                                             std::to_string(pick.block[2]) + " type " + std::to_string(pick.type.get()) + "\n" : "") +
+                                 "Settings:" + std::to_string(current_settings) + " => " + std::to_string(current_settings_val) + "\n" +
+                                 "ms p50/95/99/max: " + percentilesToString(m_frame_statistics.recent(FRAME_STATISTICS_WINDOW, m_frame_statistics_scratch))
             );
 #else // demo
             m_screen_text.update(
@@ -149,13 +179,21 @@ void Voxel::run()
         if (scroll > 0.1) m_window.unlockMouse();
         else if (scroll < -0.1) m_window.lockMouse();
 
-        // update position and stuff
-        m_player.updateSpeed(m_settings.get(SPD_P));
-        m_player.updateCameraAndItems();
-        m_player.updateVelocity(static_cast<float>(delta_time));
-        m_player.applyVelocity(static_cast<float>(delta_time));
+        // fixed steps, so the simulation costs and does the same at any frame rate
+        unsimulated_time = std::min(unsimulated_time + delta_time, MAX_TICKS_PER_FRAME * TICK_TIME);
+
+        while (unsimulated_time >= TICK_TIME)
+        {
+            tick();
+            unsimulated_time -= TICK_TIME;
+        }
+
+        // the camera is drawn between the last two steps, everything is drawn relative to the player's origin
+        const auto origin = m_player.getOrigin();
+        const auto eye = m_player.getInterpolatedPosition(static_cast<float>(unsimulated_time / TICK_TIME));
+
         m_camera.updateAspectRatio(static_cast<float>(m_window.aspectRatio()));
-        m_camera.update(m_player.getPosition()
+        m_camera.update(eye
 #if 0
                         + glm::vec3{ 0, 150, 0 }
 #endif
@@ -174,10 +212,17 @@ void Voxel::run()
         glUniform1f(m_block_light_location, light);
         glUniform3f(m_block_lighting_location, r, g, b);
 
-        const auto center = m_player.getPosition();
+        m_frame_statistics.endPhase(FrameStatistics::Phase::POLL);
+
+        m_world.update(m_player.getBlockPosition());
+        m_frame_statistics.endPhase(FrameStatistics::Phase::COMMANDS);
+
         f32Vec4 frustum_planes[6];
         matrixToFrustums(VP_matrix, frustum_planes);
-        m_world.draw(int_floor(f32Vec3{ center.x, center.y, center.z }), frustum_planes, m_chunk_position_location);
+        m_world.cull(frustum_planes, origin);
+        m_frame_statistics.endPhase(FrameStatistics::Phase::CULLING);
+
+        m_world.draw(m_chunk_position_location, origin);
 
         // render text
         m_text_shader.use();
@@ -186,21 +231,89 @@ void Voxel::run()
         m_screen_text.draw();
 
         // TODO: render sky box
+        m_frame_statistics.endPhase(FrameStatistics::Phase::DRAW);
 
         m_window.swapResizeClearBuffer();
+        m_frame_statistics.endPhase(FrameStatistics::Phase::SWAP);
 
         // limit frame rate
         const auto time_after_render = glfwGetTime();
         const auto sleep_time = 1.0 / TARGET_FRAME_RATE - (time_after_render - current_time);
         if (sleep_time > 0.0)
             std::this_thread::sleep_for(std::chrono::milliseconds(static_cast<int64_t>(sleep_time * 1000.0)));
+        m_frame_statistics.endPhase(FrameStatistics::Phase::SLEEP);
 
         { const GLenum r = glGetError(); assert(r == GL_NO_ERROR); }
 
+        m_frame_statistics.endFrame();
     }
 
     m_window.unlockMouse();
     m_window.swapResizeClearBuffer();
+
+    reportFrameStatistics();
+
+#ifdef INPUT_RECORD
+    std::cout << "Recorded " << m_input_recorder.ticks() << " steps to " << INPUT_RECORD << "." << std::endl;
+#endif
+#ifdef INPUT_PLAYBACK
+    std::cout << "Played " << m_input_playback.ticks() << " steps, " << m_input_playback.divergedTicks() << " off the recorded path";
+    if (m_input_playback.firstDivergence() != -1) std::cout << " from step " << m_input_playback.firstDivergence();
+    std::cout << "." << std::endl;
+#endif
+}
+
+//==============================================================================
+void Voxel::tick()
+{
+    const auto tick_time = static_cast<float>(TICK_TIME);
+    auto input = Player::readDevices(static_cast<float>(m_settings.get(SPD_P)));
+
+#ifdef INPUT_PLAYBACK
+    if (!m_input_playback.next(input))
+    {
+        m_input_done = true;
+        return;
+    }
+#endif
+
+    m_player.setInput(input);
+    m_player.updateCameraAndItems();
+    m_player.updateVelocity(tick_time);
+    m_player.applyVelocity(tick_time, m_world);
+
+#ifdef INPUT_RECORD
+    m_input_recorder.record(input, m_player);
+#endif
+#ifdef INPUT_PLAYBACK
+    m_input_playback.check(m_player);
+#endif
+}
+
+//==============================================================================
+void Voxel::reportFrameStatistics() const
+{
+    Debug::print("Frames: ", m_frame_statistics.frameCount(), " ms p50/95/99/max: ", percentilesToString(m_frame_statistics.session()));
+
+    for (int i = 0; i < FrameStatistics::PHASE_COUNT; ++i)
+    {
+        const auto phase = static_cast<FrameStatistics::Phase>(i);
+        Debug::print("  ", FrameStatistics::name(phase), ": ", percentilesToString(m_frame_statistics.session(phase)));
+    }
+
+#ifdef NEW_REGION_FORMAT
+    const auto flush = m_world.flushStatistics();
+    Debug::print("Region flushes: ", flush.flushed_regions, ", latency last/max: ", flush.last_latency_ms, "/", flush.max_latency_ms, " ms, backlog: ", flush.dirty_regions, " regions, ", flush.dirty_bytes, " bytes");
+#endif
+
+#ifdef FRAME_STATISTICS_CSV
+    if (!m_frame_statistics.dumpCSV(FRAME_STATISTICS_CSV))
+        std::cout << "Writing " << FRAME_STATISTICS_CSV << " failed." << std::endl;
+#endif
+#ifdef FRAME_STATISTICS_JSON
+    if (!m_frame_statistics.dumpJSON(FRAME_STATISTICS_JSON))
+        std::cout << "Writing " << FRAME_STATISTICS_JSON << " failed." << std::endl;
+#endif
 }
 
 //==============================================================================
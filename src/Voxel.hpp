@@ -8,6 +8,8 @@
 #include "Player.hpp"
 #include "TextureArray.hpp"
 #include "Text.hpp"
+#include "FrameStatistics.hpp"
+#include "InputRecording.hpp"
 
 //==============================================================================
 class Voxel
@@ -42,12 +44,30 @@ private:
 #define SPD_P 4
     GenericSettings<10> m_settings;
 
+    FrameStatistics m_frame_statistics;
+    std::vector<float> m_frame_statistics_scratch;
+
+#ifdef INPUT_PLAYBACK
+    InputPlayback m_input_playback;
+#endif
+#ifdef INPUT_RECORD
+    InputRecorder m_input_recorder;
+#endif
+    bool m_input_done{ false }; // playback is over
+
     static constexpr double FRAME_RATE_UPDATE_RATE{ 6.0 };
+    static constexpr int FRAME_STATISTICS_WINDOW{ 1000 }; // frames shown in the on screen percentiles
+    static constexpr float PICK_DISTANCE{ 8.0f }; // in blocks
 
     static constexpr double TARGET_FRAME_RATE{ // TODO: figure out why low value < 50.0 makes the keyboard feel sticky (GLFW fault!)
             SETTINGS_TARGET_FPS
     };
 
+    static constexpr double TICK_TIME{ 1.0 / SETTINGS_TICK_RATE };
+    static constexpr int MAX_TICKS_PER_FRAME{ 8 }; // beyond that the simulation runs slower instead of falling further behind
+
     void updateSettings();
+    void tick(); // one fixed simulation step
+    void reportFrameStatistics() const;
 
 };
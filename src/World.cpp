@@ -1,18 +1,31 @@
 #include "World.hpp"
 #include "QuadEBO.hpp"
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 #include "TinyAlgebraExtensions.hpp"
 #include "Debug.hpp"
 #include "Profiler.hpp"
+#include "TerrainPipeline.hpp"
 #include <cstring>
+#include <cstdio>
 #include <fstream>
+#include <limits>
+#include <stdexcept>
 #include <malloc.h>
 #include <stdlib.h>
-#include <glm/gtc/noise.hpp>
 
 static constexpr i32Vec3 INITIAL_CENTER_CHUNK{ 0, 0, 0 };
 
+//==============================================================================
+// strict ordering of positions, z major like the chunk layout
+static bool lessZYX(const i32Vec3 & a, const i32Vec3 & b)
+{
+    if (a[2] != b[2]) return a[2] < b[2];
+    if (a[1] != b[1]) return a[1] < b[1];
+    return a[0] < b[0];
+}
+
 //==============================================================================
 constexpr char World::WORLD_ROOT[];
 constexpr char World::MESH_CACHE_ROOT[];
@@ -28,9 +41,24 @@ constexpr unsigned char World::SHADDOW_STRENGTH;
 constexpr i32Vec3 World::MESH_CONTAINER_SIZES;
 constexpr i32Vec3 World::MESH_SIZES;
 constexpr i32Vec3 World::MESH_OFFSETS;
+constexpr i32Vec3 World::MESH_GROUP_SIZES;
+constexpr i32Vec3 World::MESH_GROUP_CONTAINER_SIZES;
+constexpr int World::MESH_GROUP_CAPACITY;
 constexpr i32Vec3 World::chunk_container_size;
 constexpr int World::SLEEP_MS;
 constexpr int World::STALL_SLEEP_MS;
+constexpr int World::IO_THREAD_COUNT;
+constexpr int World::CHUNK_CACHE_CAPACITY;
+constexpr int World::COLUMN_CACHE_CAPACITY;
+constexpr std::size_t World::REGION_CACHE_BUDGET;
+constexpr int World::FLUSH_INTERVAL_MS;
+constexpr std::size_t World::FLUSH_BYTES_PER_TICK;
+constexpr Codec World::CHUNK_CODEC;
+constexpr int World::PALETTE_MAX_BITS;
+constexpr std::size_t World::PALETTE_MAX_SIZE;
+constexpr std::size_t World::REGION_MESH_STATUSES_SIZE;
+constexpr std::size_t World::REGION_SUMMARIES_OFFSET;
+constexpr std::size_t World::REGION_USER_HEADER_SIZE;
 
 //==============================================================================
 World::World() :
@@ -49,21 +77,11 @@ World::World() :
 
     for (auto & i : m_blocks) i = { 0 };
 
+#ifndef NEW_REGION_FORMAT
     for (auto & i : m_regions)
     {
         i.position = { 0, 0, 0 };
-#ifndef NEW_REGION_FORMAT
         for (auto & i2 : i.metas) i2 = { 0, 0 };
-#else
-        for (auto & i2 : i.metas)
-        {
-            // i2 = { 0, CType::NOWHERE, 0 };
-            i2.location = nullptr;
-            i2.size = 0;
-            i2.loc = CType::NOWHERE;
-            i2.offset_n = 0;
-        }
-#endif
         for (auto & i3 : i.mesh_statuses) i3 = Region::MStatus::UNKNOWN;
 
         i.data = nullptr;
@@ -72,6 +90,7 @@ World::World() :
         i.needs_save = false;
     }
     m_regions[{ 0, 0, 0 }].position = { 1, 0, 0 };
+#endif
 
     for (auto & i : m_mesh_caches)
     {
@@ -89,6 +108,10 @@ World::World() :
     //m_loader_thread = std::thread{ &World::meshLoader, this };
     for (std::size_t i = 0; i < THREAD_COUNT; ++i)
         m_workers[i] = std::thread{ &World::multiThreadMeshLoader, this, i };
+
+#ifdef NEW_REGION_FORMAT
+    m_flusher = std::thread{ &World::flushLoop, this };
+#endif
 }
 
 //==============================================================================
@@ -98,6 +121,15 @@ World::~World()
 
     exitLoaderThread();
 
+#ifdef NEW_REGION_FORMAT
+    {
+        std::unique_lock<std::mutex> lock{ m_flush_lock };
+        m_flush_quit = true;
+    }
+    m_flush_condition.notify_all();
+    m_flusher.join();
+#endif
+
     Debug::print("Saving unsaved chunks.");
 
     // check all chunks if they need to be saved and save them
@@ -106,10 +138,13 @@ World::~World()
 #ifndef NEW_REGION_FORMAT
             saveChunkToRegionOld(chunk_status.position);
 #else
-            // TODO: implement !!!!!!!!!
-            //saveChunkToRegionNew(chunk_status.position);
+            // chunks are stored in their region when they are generated, the regions are saved below
             (void)0;
 #endif
+#ifdef NEW_REGION_FORMAT
+    // save all loaded regions
+    m_regions.forEach([this](const Region & region) { saveRegionToDriveNew(region.position); });
+#else
     // TODO: refactor
     // save all valid regions
     bool first_deelete_that = true;
@@ -122,22 +157,15 @@ World::~World()
             if (all(region.position == i32Vec3{ 1, 0, 0 }))
                 continue;
             else
-#ifdef NEW_REGION_FORMAT
-                saveRegionToDriveNew(region.position);
-#else
                 saveRegionToDriveOld(region.position);
-#endif
         }
         else
         {
             if (!all(region.position == i32Vec3{ 0, 0, 0 }))
-#ifdef NEW_REGION_FORMAT
-                saveRegionToDriveNew(region.position);
-#else
                 saveRegionToDriveOld(region.position);
-#endif
         }
     }
+#endif
 
     // save all mesh caches to drive
     bool first_TODO_delete = true;
@@ -160,10 +188,27 @@ World::~World()
         }*/
     }
 
+    // regions evicted before exiting
+    m_io.drain();
+
+#ifdef NEW_REGION_FORMAT
+    Debug::print("Chunk cache hits: ", m_chunk_cache.hits(), ", misses: ", m_chunk_cache.misses(), ".");
+#endif
+    Debug::print("Column cache hits: ", m_column_cache.hits(), ", misses: ", m_column_cache.misses(), ".");
+
+    if (TerrainPipeline::chunks() > 0)
+        for (int i = 0; i < static_cast<int>(TerrainPipeline::Stage::last); ++i)
+        {
+            const auto stage = static_cast<TerrainPipeline::Stage>(i);
+            Debug::print("Terrain ", TerrainPipeline::name(stage), ": ", TerrainPipeline::seconds(stage) * 1e6 / static_cast<double>(TerrainPipeline::chunks()), " us per chunk.");
+        }
+
     Debug::print("Cleaning up memory.");
 
     // cleanup
+#ifndef NEW_REGION_FORMAT
     for (auto & i : m_regions) std::free(i.data);
+#endif
 
     // delete vertex and vao buffers from active meshes
     const auto * i = m_meshes.begin();
@@ -199,132 +244,174 @@ World::~World()
 //==============================================================================
 void World::loadRegionNew(const i32Vec3 region_position)
 {
-    auto & region = m_regions[region_position];
+    // the region stays pinned until the next sphere layer is loaded
+    bool loaded = false;
+    auto & region = m_regions.acquire(region_position, loaded, [this](Region & evicted)
+    {
+        // a running flush still uses the file
+        {
+            std::unique_lock<std::mutex> lock{ m_flush_lock };
+            m_flush_condition.wait(lock, [&] { return !evicted.flushing; });
+        }
 
-    // return if already loaded
-    if (all(region_position == region.position))
+        // the render thread may still decode a chunk it found before the region left the cache, a worker may still store one
+        {
+            std::unique_lock<std::mutex> lock{ evicted.write_lock };
+            evicted.readers_done.wait(lock, [&] { return evicted.readers[0] == 0 && evicted.readers[1] == 0 && evicted.memory_writers[0] == 0 && evicted.memory_writers[1] == 0; });
+        }
+
+        // evicted regions are written by an IO thread, loading does not wait for it
+        if (evicted.needs_save)
+            saveRegionInBackground(evicted);
+    });
+
+    if (loaded)
         return;
 
-    if (region.needs_save)
-        saveRegionToDriveNew(region.position);
+    // the file may still be written, if this region was evicted recently
+    waitForPendingSave(region_position);
+
+    region.position = region_position;
 
     const std::string file_name = WORLD_ROOT + to_string(region_position);
-    std::ifstream file{ file_name, std::ifstream::binary };
 
-    if (file.good())
+    std::size_t user_header_size = 0;
+    const auto format = RegionFile::detect(file_name, &user_header_size);
+
+    if (format == RegionFile::Format::UNKNOWN)
+        convertLegacyRegion(file_name);
+    else if (format == RegionFile::Format::SECTORS && user_header_size != REGION_USER_HEADER_SIZE)
+        upgradeRegion(file_name);
+
+    if (region.file.open(file_name, CHUNK_REGION_SIZE, REGION_USER_HEADER_SIZE))
     {
         Debug::print("Loading region ", to_string(region_position));
 
-        // get rid of old data
-        std::free(region.data);
-        region.data_memory.reset();
-
-        region.position = region_position;
+        // only the header is read, chunk data is read in place
+        static_assert(sizeof(region.mesh_statuses) == REGION_MESH_STATUSES_SIZE, "Header size mismatch.");
+        region.file.readUserHeader(region.mesh_statuses.begin(), 0, sizeof(region.mesh_statuses));
 
-        file.read(reinterpret_cast<char *>(&region.size), sizeof(region.size));
-        file.read(reinterpret_cast<char *>(region.metas.begin()), sizeof(region.metas));
-        file.read(reinterpret_cast<char *>(region.mesh_statuses.begin()), sizeof(region.mesh_statuses));
+        std::unique_ptr<ChunkSummary[]> summaries{ std::make_unique<ChunkSummary[]>(CHUNK_REGION_SIZE) };
+        region.file.readUserHeader(summaries.get(), REGION_SUMMARIES_OFFSET, sizeof(ChunkSummary) * CHUNK_REGION_SIZE);
 
-        if (region.size > 0)
-        {
-            region.data = (Bytef *) std::malloc(static_cast<std::size_t>(region.size));
-            file.read(reinterpret_cast<char *>(region.data), region.size);
-        }
-        else
+        // ModTable stores elements in position_to_index() order, same as the chunk table
+        for (int i = 0; i < CHUNK_REGION_SIZE; ++i)
         {
-            region.data = nullptr;
-        }
+            const auto size = region.file.chunkSize(i);
+            const auto codec = static_cast<Codec>(region.file.chunkTag(i));
 
-        region.container_size = region.size;
+            if (size > 0 && !ChunkCodec::available(codec))
+                throw std::runtime_error("Region " + to_string(region_position) + " uses codec " + ChunkCodec::name(codec) + " which is not available in this build.");
 
-        if (!file.good()) std::runtime_error("Reading file failed.");
+            region.metas.begin()[i] = { size, size > 0 ? CType::FILE : CType::NOWHERE, codec, summaries[i], nullptr };
+        }
     }
     else
     {
-        // get rid of old data
-        std::free(region.data);
-        region.data_memory.reset();
-
-        // create region file
-        region.position = region_position;
-        region.size = 0;
-        region.data = nullptr;
-        region.container_size = 0;
-        for (auto & i : region.metas) i = { 0, CType::NOWHERE, 0 };
+        // region file is created when saving
+        for (auto & i : region.metas) i = { 0, CType::NOWHERE, CHUNK_CODEC, ChunkSummary{}, nullptr };
         for (auto & i : region.mesh_statuses) i = Region::MStatus::UNKNOWN;
     }
 
+    region.dirty_bytes = 0;
+    region.flushing = false;
     region.needs_save = false;
+
+    {
+        std::unique_lock<std::mutex> lock{ region.write_lock };
+        region.ready = true;
+    }
 }
 
 //==============================================================================
-void World::loadChunkToChunkContainerNew(const i32Vec3 chunk_position, Block * const chunk, i32Vec3 * const chunk_container_meta)
+const char * World::chunkData(const Region & region, const i32Vec3 chunk_position)
 {
-    // if already loaded
-    if (all(*chunk_container_meta == chunk_position))
-        return;
+    const auto & chunk_meta = region.metas[chunk_position];
 
-    const auto region_position = floor_div(chunk_position, CHUNK_REGION_SIZES);
-    auto & chunk_region = m_regions[region_position];
-    assert(all(chunk_region.position == region_position) && "Assuming that correct region is already loaded.");
+    switch (chunk_meta.loc)
+    {
+        case CType::FILE: return region.file.chunk(position_to_index(chunk_position, CHUNK_REGION_SIZES));
+        case CType::MEMORY: return reinterpret_cast<const char *>(chunk_meta.location);
+        default: return nullptr;
+    }
+}
 
-    auto & chunk_meta = chunk_region.metas[chunk_position];
+//==============================================================================
+bool World::beginChunkRead(Region & region, const i32Vec3 chunk_position, ChunkMeta & chunk_meta, const char * & source, int & epoch)
+{
+    // edits and flushes publish chunks again, so the meta is copied under the lock. the data it
+    // points to is not reused until endChunkRead()
+    std::unique_lock<std::mutex> lock{ region.write_lock };
+
+    if (!region.ready)
+        return false;
 
-    // update mesh status // TODO: do this when sure that chunk is present and can be loaded
-    *chunk_container_meta = chunk_position;
+    chunk_meta = region.metas[chunk_position];
+    source = chunkData(region, chunk_position);
+    epoch = region.read_epoch;
+    ++region.readers[epoch];
 
-    // chunk must exist
-    assert(chunk_meta.size != 0 && "Want to load nonexisting chunk.");
+    return true;
+}
 
-    // load chunk from region
+//==============================================================================
+void World::rereadChunk(Region & region, const i32Vec3 chunk_position, ChunkMeta & chunk_meta, const char * & source)
+{
+    // the read that is still open keeps whatever the new meta points to alive as well
+    std::unique_lock<std::mutex> lock{ region.write_lock };
 
-    // TODO: no need for locking if everything is correctly implemented (aka. realloc is removed)
-    // std::unique_lock<std::mutex>{ chunk_region.write_lock };
+    chunk_meta = region.metas[chunk_position];
+    source = chunkData(region, chunk_position);
+}
 
-    if (chunk_meta.loc == CType::FILE)
-    {
-        // address of first block
-        auto * beginning_of_chunk = chunk;
+//==============================================================================
+void World::endChunkRead(Region & region, const int epoch)
+{
+    std::unique_lock<std::mutex> lock{ region.write_lock };
 
-        // load chunk from region
-        uLongf destination_length = static_cast<uLongf>(CHUNK_DATA_SIZE);
+    assert(region.readers[epoch] > 0 && "Ended more reads than began.");
 
-        const auto * source = chunk_region.data + chunk_meta.offset_n;
+    if (--region.readers[epoch] == 0)
+        region.readers_done.notify_all();
+}
 
-        auto result = uncompress(
-            reinterpret_cast<Bytef *>(beginning_of_chunk), &destination_length,
-            source, static_cast<uLongf>(chunk_meta.size)
-        );
+//==============================================================================
+void World::decodeChunk(const ChunkMeta & chunk_meta, const char * const source, Block * const chunk)
+{
+    // chunk must exist
+    assert(chunk_meta.size != 0 && source != nullptr && "Loading chunk that does not exist.");
 
-        assert(result == Z_OK && destination_length == CHUNK_DATA_SIZE && "Error in decompression.");
-    }
-    else if (chunk_meta.loc == CType::MEMORY)
-    {
-        //assert(false && "to do: impelment.");
+    const auto result = ChunkCodec::decompress(
+        chunk_meta.codec, reinterpret_cast<char *>(chunk), CHUNK_DATA_SIZE,
+        source, static_cast<std::size_t>(chunk_meta.size), CHUNK_SIZES
+    );
 
-        // address of first block
-        auto * beginning_of_chunk = chunk;
+    assert(result && "Error in decompression.");
+    (void)result;
+}
 
-        // load chunk from region
-        uLongf destination_length = static_cast<uLongf>(CHUNK_DATA_SIZE);
+//==============================================================================
+void World::loadChunkToChunkContainerNew(const i32Vec3 chunk_position, Block * const chunk)
+{
+    const auto region_position = floor_div(chunk_position, CHUNK_REGION_SIZES);
+    auto & chunk_region = m_regions[region_position];
+    assert(all(chunk_region.position == region_position) && "Assuming that correct region is already loaded.");
 
-        const auto * source = chunk_meta.location;
+    ChunkMeta chunk_meta;
+    const char * source;
+    int epoch;
 
-        auto result = uncompress(
-            reinterpret_cast<Bytef *>(beginning_of_chunk), &destination_length,
-            source, static_cast<uLongf>(chunk_meta.size)
-        );
+    const auto ready = beginChunkRead(chunk_region, chunk_position, chunk_meta, source, epoch);
+    assert(ready && "Loader threads only read loaded regions.");
+    (void)ready;
 
-        assert(result == Z_OK && destination_length == CHUNK_DATA_SIZE && "Error in decompression.");
-    }
-    else
-    {
-        assert(false && "Loading chunk that does not exist.");
-    }
+    decodeChunk(chunk_meta, source, chunk);
+
+    endChunkRead(chunk_region, epoch);
 }
 
 //==============================================================================
-std::vector<Vertex> World::generateMeshNew(const i32Vec3 mesh_position, /*const i32Vec3 chunk_container_size,*/ Block * const chunks, i32Vec3 * const chunk_metas)
+std::vector<Vertex> World::generateMeshNew(const i32Vec3 mesh_position)
 {
     const auto from_block = mesh_position * CHUNK_SIZES + MESH_OFFSETS;
     const auto to_block = from_block + CHUNK_SIZES;
@@ -336,24 +423,26 @@ std::vector<Vertex> World::generateMeshNew(const i32Vec3 mesh_position, /*const
     const auto chunk_position_from = floor_div(from_block, CHUNK_SIZES);
     const auto chunk_position_to = floor_div(to_block - 1, CHUNK_SIZES);
 
+    // neighbouring meshes share chunks, the cache decodes each of them once for all threads
+    ChunkCache::Handle handles[product_constexpr(chunk_container_size)];
+    const Block * chunks[product_constexpr(chunk_container_size)];
+
     i32Vec3 position;
 
     for (position[2] = chunk_position_from[2]; position[2] <= chunk_position_to[2]; ++position[2])
         for (position[1] = chunk_position_from[1]; position[1] <= chunk_position_to[1]; ++position[1])
             for (position[0] = chunk_position_from[0]; position[0] <= chunk_position_to[0]; ++position[0])
             {
-                //loadChunkToChunkContainer(position);
-                const auto index = position_to_index(position, chunk_container_size) * CHUNK_SIZE;
-                auto * this_chunk = chunks + index;
-                auto * this_chunk_meta = chunk_metas + index;
+                const auto index = position_to_index(position, chunk_container_size);
 
-                loadChunkToChunkContainerNew(position, this_chunk, this_chunk_meta);
+                handles[index] = m_chunk_cache.get(position, [this, position](Block * const chunk) { loadChunkToChunkContainerNew(position, chunk); });
+                chunks[index] = handles[index].blocks();
             }
 
     class Getttter
     {
     public:
-        Getttter(const Block * const w) : worldd{ w } {}
+        Getttter(const Block * const * const w) : worldd{ w } {}
         // TODO: fix this position_to_index is not the correct function (more processing of block_position needed. See getBlock() )
         const Block & operator () (const i32Vec3 block_position)
         {
@@ -363,11 +452,11 @@ std::vector<Vertex> World::generateMeshNew(const i32Vec3 mesh_position, /*const
             const auto chunk_position = floor_div(block_position, World::CHUNK_SIZES);
             const auto chunk_index = position_to_index(chunk_position, World::chunk_container_size);
 
-            return worldd[chunk_index * World::CHUNK_SIZE + block_index];
+            return worldd[chunk_index][block_index];
         }
 
     private:
-        const Block * const worldd;
+        const Block * const * const worldd;
 
     };
     return generateMesh(from_block, to_block, Getttter{ chunks });
@@ -607,85 +696,22 @@ unsigned char World::vertexAO(const bool side_a, const bool side_b, const bool c
 //==============================================================================
 void World::generateChunkNew(Block *destination, const i32Vec3 from_block, const i32Vec3 to_block, const WorldType world_type)
 {
-    switch(world_type)
+    if (!Terrain::hasColumns(world_type))
     {
-        case WorldType::SINE: sineChunkNew(destination, from_block, to_block); break;
-        case WorldType::SIMPLEX_2D: simplex2DChunkNew(destination, from_block, to_block); break;
-        case WorldType::EMPTY: emptyChunkNew(destination, from_block, to_block); break;
-        default: throw "Not implemented."; break;
+        Terrain::generate(destination, from_block, to_block, world_type, WORLD_SEED);
+        return;
     }
-}
-
-//==============================================================================
-void World::emptyChunkNew(Block * destination, const i32Vec3 from_block, const i32Vec3 to_block)
-{
-    i32Vec3 position;
-    int i = 0;
-
-    for (position[2] = from_block[2]; position[2] < to_block[2]; ++position[2])
-        for (position[1] = from_block[1]; position[1] < to_block[1]; ++position[1])
-            for (position[0] = from_block[0]; position[0] < to_block[0]; ++position[0])
-                destination[i++] = Block{ 0 };
-}
-
-//==============================================================================
-void World::simplex2DChunkNew(Block * destination, const i32Vec3 from_block, const i32Vec3 to_block)
-{
-    i32Vec3 position;
-    int i = 0;
-
-    for (position[2] = from_block[2]; position[2] < to_block[2]; ++position[2])
-        for (position[1] = from_block[1]; position[1] < to_block[1]; ++position[1])
-            for (position[0] = from_block[0]; position[0] < to_block[0]; ++position[0])
-            {
-                auto & block = destination[i++];
-                const glm::vec2 f_position{ position[0], position[2] };
-                const float y_position = position[1];
-                const auto res = glm::simplex(f_position * 0.03f);
-                if (res * 5.0f > y_position)
-                {
-                    auto random_value = std::rand() % 16;
-
-                    if (random_value < 3)
-                        block = Block{ 3 };
-                    else if (random_value < 11)
-                        block = Block{ 2 };
-                    else
-                        block = Block{ 1 };
-                }
-                else
-                    block = Block{ 0 };
-
-            }
-}
 
-//==============================================================================
-void World::sineChunkNew(Block * destination, const i32Vec3 from_block, const i32Vec3 to_block)
-{
-    i32Vec3 position;
-    int i = 0;
-
-    for (position[2] = from_block[2]; position[2] < to_block[2]; ++position[2])
-        for (position[1] = from_block[1]; position[1] < to_block[1]; ++position[1])
-            for (position[0] = from_block[0]; position[0] < to_block[0]; ++position[0])
-            {
-                auto & block = destination[i++];
+    // chunks above and below need the same columns
+    const auto chunk_position = floor_div(from_block, CHUNK_SIZES);
+    Terrain::Columns columns;
 
-                if (std::sin(position[0] * 0.1f) * std::sin(position[2] * 0.1f) * 10.0f > static_cast<float>(position[1]))
-                {
-                    auto random_value = std::rand() % 16;
-
-                    if (random_value < 3)
-                        block = Block{ 3 };
-                    else if (random_value < 11)
-                        block = Block{ 2 };
-                    else
-                        block = Block{ 1 };
-                }
-                else
-                    block = Block{ 0 };
+    m_column_cache.get({ chunk_position[0], chunk_position[2] }, columns, [=](Terrain::Columns & destination)
+    {
+        Terrain::columns(destination, from_block, to_block, world_type, WORLD_SEED);
+    });
 
-            }
+    Terrain::generate(destination, from_block, to_block, world_type, WORLD_SEED, columns);
 }
 
 //==============================================================================
@@ -700,19 +726,13 @@ bool World::removeOutOfRangeMeshes(const i32Vec3 center_mesh)
     {
         const auto mesh_position = m_loaded_meshes[i].position;
 
-        const auto mesh_index = position_to_index(mesh_position, MESH_CONTAINER_SIZES);
-
         if (!inRange(center_mesh, mesh_position, SQUARE_REMOVE_DISTANCE))
         {
             if (!m_loaded_meshes[i].empty)
             {
-                auto * command = m_commands.initPush();
-
-                if (command != nullptr)
+                if (tryReserveCommand())
                 {
-                    command->type = Command::Type::REMOVE;
-                    command->index = mesh_index;
-                    m_commands.commitPush();
+                    pushCommand(Command::Type::REMOVE, mesh_position, {});
                 }
                 else
                 {
@@ -744,14 +764,6 @@ void World::multiThreadMeshLoader(const int thread_id)
 {
     std::unique_ptr<Block[]> container{ std::make_unique<Block[]>(CHUNK_SIZE) };
     static_assert(CSIZE == 16 && MSIZE == 16 && MOFF == 8, "Temporary.");
-    constexpr size_t SZEE = CHUNK_SIZE * product_constexpr(chunk_container_size);
-    std::unique_ptr<i32Vec3[]> chunk_positions{ std::make_unique<i32Vec3[]>(SZEE) }; // TODO: correct algorithm for determining needed size
-    std::unique_ptr<Block[]> chunks{ std::make_unique<Block[]>(SZEE) }; // TODO: correct algorithm for determining needed size
-
-    // initialize this stuff
-    for (std::size_t i = 0; i < SZEE; ++i)
-        chunk_positions[i] = { 0, 0, 0 };
-    chunk_positions[0] = { 1, 0, 0 };
 
     i32Vec3 center_chunk = m_loader_center.load();
     i32Vec3 center_mesh = center_chunk;
@@ -759,6 +771,10 @@ void World::multiThreadMeshLoader(const int thread_id)
     while (!m_quit)
     {
       //Debug::print("Thread ", thread_id, " new loop.");
+        // no thread is loading regions between two tasks, so edits can look them up
+        if (m_jobs_pending)
+            runPriorityJobs(center_mesh, container.get());
+
         auto current_index = m_iterator_index.fetch_add(1);
 
 //      if (current_index > 15500)
@@ -834,12 +850,38 @@ void World::multiThreadMeshLoader(const int thread_id)
                 const auto from_region = floor_div(from_chunk, CHUNK_REGION_SIZES);
                 const auto to_region = floor_div(to_chunk, CHUNK_REGION_SIZES);
 
+                std::vector<i32Vec3> pinned;
                 i32Vec3 position;
 
+                std::unique_lock<std::mutex> regions_lock{ m_regions_lock };
+
                 for (position[2] = from_region[2]; position[2] <= to_region[2]; ++position[2])
                     for (position[1] = from_region[1]; position[1] <= to_region[1]; ++position[1])
                         for (position[0] = from_region[0]; position[0] <= to_region[0]; ++position[0])
+                        {
                             loadRegionNew(position);
+                            pinned.push_back(position);
+                        }
+
+                // the previous layer's regions may be evicted again
+                for (const auto & p : m_pinned_regions)
+                    m_regions.unpin(p);
+
+                m_pinned_regions = std::move(pinned);
+
+                regions_lock.unlock();
+
+                // read the regions of the next sphere layer while this one is generated
+                for (auto next = current_index + 1; next < static_cast<int>(m_iterator.m_points.size()); ++next)
+                {
+                    const auto & next_task = m_iterator.m_points[next];
+
+                    if (next_task.task != SphereIterator<RDISTANCE, THREAD_COUNT>::Task::LAST_SYNC_AND_LOAD_REGION)
+                        continue;
+
+                    prefetchRegions(((next_task.position * -1) + 1) + center_chunk, next_task.position + center_chunk);
+                    break;
+                }
 
                 m_barrier.wait();
             }
@@ -856,7 +898,13 @@ void World::multiThreadMeshLoader(const int thread_id)
 
                 if (chunk_meta.loc == CType::NOWHERE)
                 {
-                    generateChunkNew(container.get(), from, to, WorldType::SIMPLEX_2D);
+                    // sky needs no generator, it is stored as a single value
+                    Block uniform_value;
+                    if (Terrain::uniform(from, to, WORLD_GENERATOR, uniform_value))
+                        std::fill(container.get(), container.get() + CHUNK_SIZE, uniform_value);
+                    else
+                        generateChunkNew(container.get(), from, to, WORLD_GENERATOR);
+
                     saveChunkToRegionNew(container.get(), chunk_position);
                 }
             }
@@ -877,34 +925,52 @@ void World::multiThreadMeshLoader(const int thread_id)
                 auto & chunk_region = m_regions[region_position];
                 auto & mesh_status = chunk_region.mesh_statuses[current_mesh_position];
 
+                const auto & version = m_mesh_versions[position_to_index(current_mesh_position, MESH_CONTAINER_SIZES)];
+                std::unique_lock<std::mutex> loaded_lock{ m_loaded_meshes_lock, std::defer_lock };
                 std::vector<Vertex> mesh;
-                if (mesh_status != Region::MStatus::EMPTY)
-                {
-                    mesh = generateMeshNew(current_mesh_position,
-                        //chunk_container_size,
-                       chunks.get(), chunk_positions.get());
-                }
+                bool reserved = false;
 
-                if (mesh.size() != 0)
+                // an edit while meshing makes the result stale, then it is meshed again.
+                // the check and publishing the mesh are under one lock, remesh() relies on that
+                while (true)
                 {
-                    std::unique_lock<std::mutex> lock { m_ring_buffer_lock };
+                    const auto started_version = version.load();
 
-                    auto * command = m_commands.initPush();
+                    // resolved from chunk summaries, nothing is decoded
+                    if (mesh_status == Region::MStatus::UNKNOWN && meshProvenEmpty(current_mesh_position))
+                        mesh_status = Region::MStatus::EMPTY;
 
-                    // buffer is full
-                    while (command == nullptr) // TODO: fix that: exit + buffer_stall = deadlock because worker threads are waiting for queue to have space and render thread will not empty the queue
+                    mesh.clear();
+                    if (mesh_status != Region::MStatus::EMPTY)
                     {
-                        std::cout << "Buffer stall. Sleeping" << std::endl;
-                        std::this_thread::sleep_for(std::chrono::milliseconds(100));
-                        command = m_commands.initPush();
+                        mesh = generateMeshNew(current_mesh_position);
                     }
 
-                    command->type = Command::Type::UPLOAD;
-                    command->index = position_to_index(current_mesh_position, MESH_CONTAINER_SIZES);
-                    command->position = current_mesh_position;
-                    command->mesh = mesh;
+                    // wait for a command slot before locking, nothing can wait while holding the lock
+                    reserved = !mesh.empty() && reserveCommand();
 
-                    m_commands.commitPush();
+                    if (!mesh.empty() && !reserved)
+                        break; // exiting
+
+                    loaded_lock.lock();
+
+                    if (started_version == version.load())
+                        break;
+
+                    loaded_lock.unlock();
+
+                    if (reserved)
+                        releaseCommand();
+                }
+
+                if (!mesh.empty() && !reserved)
+                    continue;
+
+                const bool empty = mesh.empty();
+
+                if (!empty)
+                {
+                    pushCommand(Command::Type::UPLOAD, current_mesh_position, mesh);
 
                     if (mesh_status == Region::MStatus::UNKNOWN)
                         mesh_status = Region::MStatus::NON_EMPTY;
@@ -918,8 +984,7 @@ void World::multiThreadMeshLoader(const int thread_id)
                 // update mesh state
                 // no need for locking ?
                 m_mesh_loaded[current_mesh_position] = Status::LOADED;
-                std::unique_lock<std::mutex> lock{ m_loaded_meshes_lock };
-                m_loaded_meshes.push_back({current_mesh_position, mesh.size() == 0});
+                m_loaded_meshes.push_back({current_mesh_position, empty});
             }
             break;
             case SphereIterator<RDISTANCE, THREAD_COUNT>::Task::END_MARKER:
@@ -928,7 +993,11 @@ void World::multiThreadMeshLoader(const int thread_id)
 
                 m_iterator_index = 0;
 
-                std::this_thread::sleep_for(std::chrono::milliseconds(200)); // TODO: replace with condition variable, that signals when the need to start workers exists
+                // the sphere is done, wait for a while before checking it again. edits start the threads right away
+                {
+                    std::unique_lock<std::mutex> lock{ m_edit_lock };
+                    m_edit_condition.wait_for(lock, std::chrono::milliseconds(200), [this] { return m_jobs_pending || m_quit; });
+                }
 
                 m_barrier.wait();
             }
@@ -971,18 +1040,24 @@ void World::executeRendererCommands(const int max_command_count)
 {
     auto commands_executed = 0;
 
-    while (commands_executed++ < max_command_count)
+    while (commands_executed < max_command_count)
     {
         Command * command = m_commands.initPop();
 
         if (command == nullptr)
-            return;
+            break;
 
         switch (command->type)
         {
             case Command::Type::REMOVE:
             {
                 const auto & mesh_data = m_meshes.get_entry(command->index).mesh;
+
+                auto & group_meshes = m_mesh_groups[floor_div(m_meshes.get_entry(command->index).position, MESH_GROUP_SIZES)].meshes;
+                const auto in_group = std::find(group_meshes.begin(), group_meshes.end(), command->index);
+                assert(in_group != group_meshes.end() && "Mesh is missing from its group.");
+                *in_group = group_meshes.back();
+                group_meshes.pop_back();
 #if 1
                 assert(mesh_data.VBO && mesh_data.VAO && "Should not be 0.");
                 m_unused_buffers.push({ mesh_data.VAO, mesh_data.VBO });
@@ -1038,10 +1113,33 @@ void World::executeRendererCommands(const int max_command_count)
 
                 m_meshes.add_entry(command->index, { { VAO, VBO, EBO_size }, command->position });
 
+                const auto group_position = floor_div(command->position, MESH_GROUP_SIZES);
+                auto & group = m_mesh_groups[group_position];
+                if (group.meshes.empty()) group.position = group_position;
+                assert(all(group.position == group_position) && "Mesh group container too small.");
+                group.meshes.push_back(command->index);
+
                 // this does not deallocate and popping command queue does not call destructor
                 command->mesh.clear();
             }
             break;
+            case Command::Type::REPLACE:
+            {
+                const auto buffers = m_meshes.get_entry(command->index).mesh;
+
+                assert(command->mesh.size() > 0 && "Mesh size must be over 0.");
+                assert(buffers.VAO != 0 && buffers.VBO != 0 && "Replacing a mesh that has no buffers.");
+
+                glBindBuffer(GL_ARRAY_BUFFER, buffers.VBO);
+                glBufferData(GL_ARRAY_BUFFER, command->mesh.size() * sizeof(command->mesh[0]), command->mesh.data(), GL_STATIC_DRAW);
+                const auto EBO_size = static_cast<int>((command->mesh.size() >> 1) + command->mesh.size());
+                QuadEBO::resize(EBO_size);
+
+                m_meshes.replace_entry(command->index, { { buffers.VAO, buffers.VBO, EBO_size }, command->position });
+
+                command->mesh.clear();
+            }
+            break;
             default:
             {
                 assert(0 && "Unknown command.");
@@ -1050,11 +1148,22 @@ void World::executeRendererCommands(const int max_command_count)
         }
 
         m_commands.commitPop();
+        ++commands_executed;
     }
-}
 
-//==============================================================================
-void World::draw(const i32Vec3 new_center, const f32Vec4 frustum_planes[6], const GLint offset_uniform)
+    if (commands_executed == 0)
+        return;
+
+    {
+        std::unique_lock<std::mutex> lock{ m_ring_buffer_lock };
+        m_reserved_commands -= commands_executed;
+    }
+
+    m_commands_space.notify_all();
+}
+
+//==============================================================================
+void World::update(const i32Vec3 new_center)
 {
     const auto center_mesh = floor_div(new_center - MESH_OFFSETS, MESH_SIZES);
     const auto old_center_mesh = m_center_mesh.exchange(center_mesh);
@@ -1067,26 +1176,82 @@ void World::draw(const i32Vec3 new_center, const f32Vec4 frustum_planes[6], cons
     }
 
     executeRendererCommands(MAX_COMMANDS_PER_FRAME);
+}
+
+//==============================================================================
+void World::cull(const f32Vec4 frustum_planes[6], const i32Vec3 origin)
+{
+    // pointers stay valid until the next executeRendererCommands()
+    m_visible_meshes.clear();
 
-    // render
-    for (const auto & m : m_meshes)
+    float x[MESH_GROUP_CAPACITY], y[MESH_GROUP_CAPACITY], z[MESH_GROUP_CAPACITY];
+    bool visible[MESH_GROUP_CAPACITY];
+
+    for (auto & group : m_mesh_groups)
     {
-        // only render if not too far away
-#if 0
-        if (!inRange(center_mesh, m.data.position, SQUARE_RENDER_DISTANCE))
+        if (group.meshes.empty())
             continue;
-#endif
 
-        // only render if in frustum
-        if (!meshInFrustum(frustum_planes, m.position * MESH_SIZES + MESH_OFFSETS))
+        // integer difference first, like in draw()
+        const auto group_from = group.position * MESH_GROUP_SIZES * MESH_SIZES + MESH_OFFSETS - origin;
+        unsigned crossing_planes;
+
+        const auto containment = boxInFrustum(
+            frustum_planes,
+            f32Vec3{ static_cast<float>(group_from[0]), static_cast<float>(group_from[1]), static_cast<float>(group_from[2]) },
+            static_cast<float>(MGSIZE * MSIZE),
+            group.last_out_plane,
+            crossing_planes
+        );
+
+        if (containment == Containment::OUTSIDE)
+            continue;
+
+        if (containment == Containment::INSIDE)
+        {
+            for (const auto index : group.meshes)
+                m_visible_meshes.push_back(&m_meshes.get_entry(index));
+
             continue;
+        }
+
+        // only planes crossing the group can cut off its meshes
+        const auto count = static_cast<int>(group.meshes.size());
+        assert(count <= MESH_GROUP_CAPACITY && "Too many meshes in group.");
+
+        for (int i = 0; i < count; ++i)
+        {
+            const auto from = m_meshes.get_entry(group.meshes[i]).position * MESH_SIZES + MESH_OFFSETS - origin;
+            x[i] = static_cast<float>(from[0]);
+            y[i] = static_cast<float>(from[1]);
+            z[i] = static_cast<float>(from[2]);
+        }
+
+        boxesInFrustum(frustum_planes, crossing_planes, static_cast<float>(MSIZE), x, y, z, count, visible);
+
+        for (int i = 0; i < count; ++i)
+            if (visible[i])
+                m_visible_meshes.push_back(&m_meshes.get_entry(group.meshes[i]));
+    }
+}
+
+//==============================================================================
+void World::draw(const GLint offset_uniform, const i32Vec3 origin)
+{
+#ifndef REL_CHUNK
+    // vertices are absolute, so this only moves the precision loss into the shader
+    glUniform3f(offset_uniform, static_cast<float>(-origin[0]), static_cast<float>(-origin[1]), static_cast<float>(-origin[2]));
+#endif
 
-        const auto & mesh_data = m.mesh;
+    for (const auto * m : m_visible_meshes)
+    {
+        const auto & mesh_data = m->mesh;
 
         assert(mesh_data.size <= QuadEBO::size() && mesh_data.size > 0);
         assert(mesh_data.VAO != 0 && mesh_data.VBO != 0 && "VAO and/or VBO not loaded.");
 #ifdef REL_CHUNK
-        const auto & pos = m.position * MESH_SIZES + MESH_OFFSETS;
+        // integer difference first, it is small and exact as a float
+        const auto pos = m->position * MESH_SIZES + MESH_OFFSETS - origin;
         glUniform3f(offset_uniform, static_cast<float>(pos[0]), static_cast<float>(pos[1]), static_cast<float>(pos[2]));
 #endif
         glBindVertexArray(mesh_data.VAO);
@@ -1109,7 +1274,13 @@ void World::exitLoaderThread()
     //m_loader_thread.join();
 
 
-    m_quit = true;
+    {
+        // under the lock so a worker can't miss the wakeup between its check and its wait
+        std::unique_lock<std::mutex> lock{ m_ring_buffer_lock };
+        m_quit = true;
+    }
+    m_edit_condition.notify_all();
+    m_commands_space.notify_all();
 
     for (std::size_t i = 0; i < THREAD_COUNT; ++i)
     {
@@ -1119,65 +1290,129 @@ void World::exitLoaderThread()
 }
 
 //==============================================================================
-bool World::meshInFrustum(const f32Vec4 planes[6], const i32Vec3 mesh_offset)
+World::Containment World::boxInFrustum(const f32Vec4 planes[6], const f32Vec3 from, const float size, int & first_plane, unsigned & crossing_planes)
 {
-    const f32Vec3 from{ static_cast<float>(mesh_offset[0]), static_cast<float>(mesh_offset[1]), static_cast<float>(mesh_offset[2]) };
-    const f32Vec3 to{ from + f32Vec3{ static_cast<float>(MESH_SIZES[0]), static_cast<float>(MESH_SIZES[1]), static_cast<float>(MESH_SIZES[2]) } };
+    crossing_planes = 0;
 
-    // TODO: there are faster algorithms
-    for (auto i = 0; i < 6; ++i)
+    // the plane that rejected the box last time most likely rejects it again
+    for (int j = 0; j < 6; ++j)
     {
-#if 0 // assume sphere ?
-        float side = planePointDistance(plane[i], point);
-        if (side < -Chunk::BOUNDING_SPHERE_RADIUS)
-        return false;
-#else
-        // Reset counters for corners in and out
-        int out = 0;
-        int in = 0;
-
-        // https://sites.google.com/site/letsmakeavoxelengine/home/frustum-culling
-
-        if (dot(planes[i], f32Vec4{ from[0], from[1], from[2], 1 }) < 0.0f) ++out;
-        else ++in;
-        if (dot(planes[i], f32Vec4{ from[0], from[1], to[2], 1 }) < 0.0f) ++out;
-        else ++in;
-        if (dot(planes[i], f32Vec4{ from[0], to[1], from[2], 1 }) < 0.0f) ++out;
-        else ++in;
-        if (dot(planes[i], f32Vec4{ from[0], to[1], to[2], 1 }) < 0.0f) ++out;
-        else ++in;
-        if (dot(planes[i], f32Vec4{ to[0], from[1], from[2], 1 }) < 0.0f) ++out;
-        else ++in;
-        if (dot(planes[i], f32Vec4{ to[0], from[1], to[2], 1 }) < 0.0f) ++out;
-        else ++in;
-        if (dot(planes[i], f32Vec4{ to[0], to[1], from[2], 1 }) < 0.0f) ++out;
-        else ++in;
-        if (dot(planes[i], f32Vec4{ to[0], to[1], to[2], 1 }) < 0.0f) ++out;
-        else ++in;
-
-        // If all corners are out
-        if (in == 0) return false;
-#endif
+        const int i = (first_plane + j) % 6;
+        const auto & plane = planes[i];
+
+        // corners farthest along and against the plane normal
+        const f32Vec4 far_corner{
+            plane[0] >= 0.0f ? from[0] + size : from[0],
+            plane[1] >= 0.0f ? from[1] + size : from[1],
+            plane[2] >= 0.0f ? from[2] + size : from[2],
+            1.0f
+        };
+        const f32Vec4 near_corner{
+            plane[0] >= 0.0f ? from[0] : from[0] + size,
+            plane[1] >= 0.0f ? from[1] : from[1] + size,
+            plane[2] >= 0.0f ? from[2] : from[2] + size,
+            1.0f
+        };
+
+        // all corners out
+        if (dot(plane, far_corner) < 0.0f)
+        {
+            first_plane = i;
+            return Containment::OUTSIDE;
+        }
+
+        if (dot(plane, near_corner) < 0.0f)
+            crossing_planes |= 1u << i;
     }
 
-    return true;
+    return crossing_planes == 0 ? Containment::INSIDE : Containment::CROSSING;
+}
+
+//==============================================================================
+void World::boxesInFrustum(const f32Vec4 planes[6], const unsigned plane_mask, const float size, const float * x, const float * y, const float * z, const int count, bool * visible)
+{
+    for (int i = 0; i < count; ++i)
+        visible[i] = true;
+
+    for (int p = 0; p < 6; ++p)
+    {
+        if ((plane_mask & (1u << p)) == 0)
+            continue;
+
+        const auto & plane = planes[p];
+
+        // the farthest corner along the normal is at the same offset in every box of the same size
+        const float far_offset =
+            (plane[0] >= 0.0f ? plane[0] * size : 0.0f) +
+            (plane[1] >= 0.0f ? plane[1] * size : 0.0f) +
+            (plane[2] >= 0.0f ? plane[2] * size : 0.0f) +
+            plane[3];
+
+        // no branches or gathers, so it is vectorized and many boxes are tested at once
+        for (int i = 0; i < count; ++i)
+            visible[i] = visible[i] & (plane[0] * x[i] + plane[1] * y[i] + plane[2] * z[i] + far_offset >= 0.0f);
+    }
 }
 
 //==============================================================================
-void World::saveChunkToRegionNew(const Block * const source, const i32Vec3 chunk_position)
+bool World::saveChunkToRegionNew(const Block * const source, const i32Vec3 chunk_position, const bool replace)
 {
     const auto region_position = floor_div(chunk_position, CHUNK_REGION_SIZES);
     auto & region = m_regions[region_position];
 
-    std::unique_lock<std::mutex> lock{ region.write_lock }; // TODO: figure something out. this lock is serializing too much. compress2() is probably taking a lot of time
+#ifdef NEW_REGION_FORMAT
+    // compress into a per thread buffer without holding the lock
+    const auto capacity = std::max(PALETTE_MAX_SIZE, ChunkCodec::bound(CHUNK_CODEC, CHUNK_DATA_SIZE));
+    thread_local std::vector<char> buffer;
+    buffer.resize(capacity);
+
+    // chunks with few block types (all of the uniform ones) are stored as palette. they are decoded without real decompression
+    auto codec = Codec::PALETTE;
+    auto destination_length = ChunkCodec::compress(Codec::PALETTE, buffer.data(), PALETTE_MAX_SIZE, reinterpret_cast<const char *>(source), CHUNK_DATA_SIZE, CHUNK_SIZES);
+
+    if (destination_length == 0)
+    {
+        codec = CHUNK_CODEC;
+        destination_length = ChunkCodec::compress(CHUNK_CODEC, buffer.data(), capacity, reinterpret_cast<const char *>(source), CHUNK_DATA_SIZE, CHUNK_SIZES);
+    }
+
+    assert(destination_length > 0 && destination_length <= capacity && "Error compressing chunk.");
+
+    const auto summary = ChunkSummary::of(source, CHUNK_SIZES);
+
+    // the chunk is appended to region memory without the lock. registering first keeps the block
+    // from being recycled, a flush that switched blocks in between is seen on the second look
+    int block;
 
+    while (true)
+    {
+        block = region.current_memory.load();
+        ++region.memory_writers[block];
+
+        if (region.current_memory.load() == block)
+            break;
+
+        // the flush that switched may already wait for this block
+        std::unique_lock<std::mutex> lock{ region.write_lock };
+        --region.memory_writers[block];
+        region.readers_done.notify_all();
+    }
+
+    auto * destination = region.memory[block].allocate(destination_length);
+    std::memcpy(destination, buffer.data(), destination_length);
+
+    // only publishing the chunk is locked
+    std::unique_lock<std::mutex> lock{ region.write_lock };
+#else
+    std::unique_lock<std::mutex> lock{ region.write_lock }; // TODO: figure something out. this lock is serializing too much. compress2() is probably taking a lot of time
+#endif
 
     // check if region was changed during locking. Assuming,  that it will not be changed, while this function is executing (and also shouldn't if everything is implemented correctly)
     assert(all(region.position == region_position) && "Incorrect region loaded.");
 
+#ifndef NEW_REGION_FORMAT
     uLong destination_length = compressBound(static_cast<uLong>(CHUNK_DATA_SIZE));
 
-#ifndef NEW_REGION_FORMAT
     // resize if potentially out of space
     if (region.size + static_cast<int>(destination_length) > region.container_size)
     {
@@ -1190,26 +1425,49 @@ void World::saveChunkToRegionNew(const Block * const source, const i32Vec3 chunk
     }
 
     Bytef * const destination = region.data + region.size; // TODO: figure out if this is size in char, Bytef or Block
-#else
-    Bytef * const destination = reinterpret_cast<Bytef *>(region.data_memory.getBlock(destination_length));
-#endif
 
     const auto result = compress2(destination, &destination_length, reinterpret_cast<const Bytef *>(source), static_cast<uLong>(CHUNK_DATA_SIZE), Z_BEST_SPEED);
 
     assert(result == Z_OK && "Error compressing chunk.");
     assert(destination_length <= compressBound(static_cast<uLong>(CHUNK_DATA_SIZE)) && "ZLib lied about the maximum possible size of compressed data.");
+#endif
 
     auto & chunk_meta = region.metas[chunk_position];
 
 #ifdef NEW_REGION_FORMAT
-    region.data_memory.increaseUsedSpace(destination_length);
+    // an edit was faster than the generator, the edited chunk wins
+    if (chunk_meta.loc != CType::NOWHERE && !replace)
+    {
+        --region.memory_writers[block];
+        region.readers_done.notify_all();
+        return false;
+    }
+
+    // a flush started after the copy and did not collect the chunk, it would be lost with the old block
+    if (region.current_memory.load() != block)
+    {
+        auto * const moved = region.memory[region.current_memory].allocate(destination_length);
+        std::memcpy(moved, destination, destination_length);
+        destination = moved;
+    }
 
+    // edited chunks are published again, earlier versions are recycled after the next flush
     chunk_meta.size = static_cast<int>(destination_length);
-    chunk_meta.location = destination;
-    assert(chunk_meta.loc == CType::NOWHERE && "Chunk must not already exist when saving it.");
+    chunk_meta.codec = codec;
+    chunk_meta.summary = summary;
+    chunk_meta.location = reinterpret_cast<Bytef *>(destination);
     chunk_meta.loc = CType::MEMORY;
 
     // region.size += destination_length; <- should be computed at saving time?
+
+    if (!region.needs_save)
+        region.dirty_since = std::chrono::steady_clock::now();
+
+    region.dirty_bytes += destination_length;
+
+    // a flush waits for this before the block is recycled
+    --region.memory_writers[block];
+    region.readers_done.notify_all();
 #else
     chunk_meta.size = static_cast<int>(destination_length);
     chunk_meta.offset = region.size;
@@ -1218,84 +1476,1182 @@ void World::saveChunkToRegionNew(const Block * const source, const i32Vec3 chunk
 #endif
 
     region.needs_save = true;
+
+    return true;
 }
 
 //==============================================================================
 void World::saveRegionToDriveNew(const i32Vec3 region_position)
 {
-    //const
     auto & region = m_regions[region_position];
 
     if (!region.needs_save)
         return;
 
+    // save only if valid
     assert(all(region.position == region_position) && "Chunk was probably never initialized. Control flow should have never reached this.");
 
-    const auto from_chunk = region_position * CHUNK_REGION_SIZES; // opposite of floor_div( ... , ... )
-    const auto to_chunk = from_chunk + CHUNK_REGION_SIZES;
+    writeRegion(region.position, region.file, region.metas, region.mesh_statuses);
+
+    region.needs_save = false;
+}
+
+//==============================================================================
+void World::writeRegion(const i32Vec3 region_position, RegionFile & file, Region::Metas & metas, const Region::MeshStatuses & mesh_statuses)
+{
+    Debug::print("Saving region ", to_string(region_position));
+
+    if (!file.isOpen())
+        file.create(WORLD_ROOT + to_string(region_position), CHUNK_REGION_SIZE, REGION_USER_HEADER_SIZE);
+
+    // write chunks that are only in memory. already saved chunks are not touched
+    for (int i = 0; i < CHUNK_REGION_SIZE; ++i)
+    {
+        auto & chunk_meta = metas.begin()[i];
+
+        if (chunk_meta.loc != CType::MEMORY)
+            continue;
+
+        assert(chunk_meta.size != 0 && chunk_meta.location != nullptr && "Data structure is broken.");
+
+        file.stageChunk(i, chunk_meta.location, chunk_meta.size, static_cast<int>(chunk_meta.codec));
+        chunk_meta.location = nullptr; // don't worry the memory will be recycled automatically
+        chunk_meta.loc = CType::FILE;
+    }
+
+    std::unique_ptr<ChunkSummary[]> summaries{ std::make_unique<ChunkSummary[]>(CHUNK_REGION_SIZE) };
+    for (int i = 0; i < CHUNK_REGION_SIZE; ++i)
+        summaries[i] = metas.begin()[i].summary;
+
+    file.writeUserHeader(mesh_statuses.begin(), 0, sizeof(mesh_statuses));
+    file.writeUserHeader(summaries.get(), REGION_SUMMARIES_OFFSET, sizeof(ChunkSummary) * CHUNK_REGION_SIZE);
+
+    file.commit();
+
+    // online compaction, chunks are looked up by index so moving them is fine
+    if (file.needsCompaction())
+        file.compact();
+}
+
+//==============================================================================
+void World::saveRegionInBackground(Region & region)
+{
+    assert(region.needs_save && "Nothing to save.");
+
+    // everything the save needs is moved out of the slot, so the slot can be reused right away
+    // std::function must be copyable, hence the shared_ptr
+    auto pending = std::make_shared<PendingSave>();
+    pending->position = region.position;
+    pending->metas = region.metas;
+    pending->mesh_statuses = region.mesh_statuses;
+    pending->memory[0] = std::move(region.memory[0]);
+    pending->memory[1] = std::move(region.memory[1]);
+    pending->file = std::move(region.file);
+
+    region.needs_save = false;
+
+    {
+        std::unique_lock<std::mutex> lock{ m_pending_saves_lock };
+        m_pending_saves.push_back(pending->position);
+    }
+
+    m_io.run([this, pending]
+    {
+        writeRegion(pending->position, pending->file, pending->metas, pending->mesh_statuses);
+        pending->file.close();
+
+        {
+            std::unique_lock<std::mutex> lock{ m_pending_saves_lock };
+            const auto it = std::find_if(m_pending_saves.begin(), m_pending_saves.end(), [&](const i32Vec3 & p) { return all(p == pending->position); });
+            assert(it != m_pending_saves.end() && "Pending save was not registered.");
+            m_pending_saves.erase(it);
+        }
+
+        m_pending_saves_condition.notify_all();
+    });
+}
+
+//==============================================================================
+void World::waitForPendingSave(const i32Vec3 region_position)
+{
+    std::unique_lock<std::mutex> lock{ m_pending_saves_lock };
+
+    m_pending_saves_condition.wait(lock, [&]
+    {
+        return std::none_of(m_pending_saves.begin(), m_pending_saves.end(), [&](const i32Vec3 & p) { return all(p == region_position); });
+    });
+}
+
+//==============================================================================
+void World::prefetchRegions(const i32Vec3 from_chunk, const i32Vec3 to_chunk)
+{
+    // forget about regions that have been loaded in the meantime
+    m_prefetched_regions.erase(
+        std::remove_if(m_prefetched_regions.begin(), m_prefetched_regions.end(), [&](const i32Vec3 & p) { return m_regions.contains(p); }),
+        m_prefetched_regions.end()
+    );
+
+    const auto from_region = floor_div(from_chunk, CHUNK_REGION_SIZES);
+    const auto to_region = floor_div(to_chunk, CHUNK_REGION_SIZES);
 
     i32Vec3 position;
-    std::size_t total_size_of_chunks_in_memory{ 0 };
-    std::vector<ChunkMeta *> to_save; // TODO: flat preallocated array instead of vector
 
-    // find out what chunks need to be saved
-    for (position[2] = from_chunk[2]; position[2] <= to_chunk[2]; ++position[2])
-        for (position[1] = from_chunk[1]; position[1] <= to_chunk[1]; ++position[1])
-            for (position[0] = from_chunk[0]; position[0] <= to_chunk[0]; ++position[0])
+    for (position[2] = from_region[2]; position[2] <= to_region[2]; ++position[2])
+        for (position[1] = from_region[1]; position[1] <= to_region[1]; ++position[1])
+            for (position[0] = from_region[0]; position[0] <= to_region[0]; ++position[0])
             {
-                auto & chunk_meta = region.metas[position];
-                if (chunk_meta.loc == CType::MEMORY)
-                {
-                    assert(chunk_meta.size != 0 && chunk_meta.location != nullptr && chunk_meta.offset_n == 0 && "Data structure is broken.");
-                    total_size_of_chunks_in_memory += chunk_meta.size;
-                    //const auto * test = &chunk_meta;
-                    to_save.push_back(&(region.metas[position])); // pointer to referenced object ?
-                    //to_save.push_back(&chunk_meta);
-                    chunk_meta.loc = CType::FILE;
-                }
+                if (m_regions.contains(position))
+                    continue;
+
+                const auto already = std::any_of(m_prefetched_regions.begin(), m_prefetched_regions.end(), [&](const i32Vec3 & p) { return all(p == position); });
+
+                if (already)
+                    continue;
+
+                m_prefetched_regions.push_back(position);
+                RegionFile::prefetch(m_io, WORLD_ROOT + to_string(position));
             }
+}
 
-    // fix file size
-    if (region.size + static_cast<int>(total_size_of_chunks_in_memory) > region.container_size)
+//==============================================================================
+void World::flushLoop()
+{
+    while (true)
     {
-        //Debug::print("Reallocating region container.");
-        const auto new_container_size = region.size + static_cast<int>(total_size_of_chunks_in_memory);
-        auto * const new_data = (Bytef*)std::realloc(region.data, static_cast<std::size_t>(new_container_size));
-        if (new_data == nullptr) throw 0;
-        region.container_size = new_container_size;
-        region.data = new_data;
+        {
+            std::unique_lock<std::mutex> lock{ m_flush_lock };
+            m_flush_condition.wait_for(lock, std::chrono::milliseconds{ FLUSH_INTERVAL_MS }, [this] { return m_flush_quit; });
+
+            if (m_flush_quit)
+                return;
+        }
+
+        flushDirtyRegions();
     }
+}
+
+//==============================================================================
+void World::flushDirtyRegions()
+{
+    std::size_t written = 0;
 
-    // move to file
-    for (auto & chunk_meta : to_save)
+    // oldest changes first, until the budget for this interval is used up
+    while (written < FLUSH_BYTES_PER_TICK)
     {
-        Bytef * destination = region.data + region.size;
-        chunk_meta->offset_n = region.size;
-        region.size += chunk_meta->size;
-        std::memcpy(destination, chunk_meta->location, chunk_meta->size);
-        chunk_meta->location = nullptr; // don't worry the memory will be recycled automatically
-        chunk_meta->loc = CType::FILE;
+        // loads come first, flushing waits while the IO threads are busy
+        if (m_io.pending() > 0)
+            break;
+
+        Region * oldest = nullptr;
+        int dirty_regions = 0;
+        std::size_t dirty_bytes = 0;
+
+        {
+            std::unique_lock<std::mutex> regions_lock{ m_regions_lock };
+
+            m_regions.forEach([&](Region & region)
+            {
+                std::unique_lock<std::mutex> lock{ region.write_lock };
+
+                if (!region.needs_save)
+                    return;
+
+                ++dirty_regions;
+                dirty_bytes += region.dirty_bytes;
+
+                if (oldest == nullptr || region.dirty_since < oldest->dirty_since)
+                    oldest = &region;
+            });
+
+            m_flush_dirty_regions = dirty_regions;
+            m_flush_dirty_bytes = dirty_bytes;
+
+            if (oldest == nullptr)
+                break;
+
+            // evicting the region waits for this flag
+            std::unique_lock<std::mutex> lock{ m_flush_lock };
+            oldest->flushing = true;
+        }
+
+        written += flushRegion(*oldest);
+
+        {
+            std::unique_lock<std::mutex> lock{ m_flush_lock };
+            oldest->flushing = false;
+        }
+        m_flush_condition.notify_all();
     }
+}
 
-    assert(region.size <= region.container_size && "Oops, buffer overflow.");
+//==============================================================================
+std::size_t World::flushRegion(Region & region)
+{
+    // the region stays in use while it is flushed. chunks are staged to free sectors, which readers
+    // never look at. the table only changes under the lock, and the sectors it replaces are reused
+    // once the readers that may still decode them are done
+    struct DirtyChunk { int index; const char * data; int size; Codec codec; };
 
-    // save only if valid
-    assert(all(region_position == region.position) && "Trying to save invalid region.");
+    const auto start = std::chrono::steady_clock::now();
 
-    // save region
-    Debug::print("Saving region ", to_string(region.position));
-    assert((region.size == 0 && region.data == nullptr || region.size > 0 && region.data != nullptr) && "Data structure is broken.");
+    std::vector<DirtyChunk> chunks;
+    std::unique_ptr<ChunkSummary[]> summaries{ std::make_unique<ChunkSummary[]>(CHUNK_REGION_SIZE) };
+    std::unique_ptr<Region::MeshStatuses> mesh_statuses{ std::make_unique<Region::MeshStatuses>() };
+    std::size_t bytes = 0;
+    int flushed;
 
-    const std::string file_name = WORLD_ROOT + to_string(region.position);
-    std::ofstream file{ file_name, std::ofstream::out | std::ofstream::binary | std::ofstream::trunc };
+    {
+        std::unique_lock<std::mutex> lock{ region.write_lock };
 
-    file.write(reinterpret_cast<const char *>(&region.size), sizeof(region.size));
-    file.write(reinterpret_cast<const char *>(region.metas.begin()), sizeof(region.metas));
-    file.write(reinterpret_cast<const char *>(region.mesh_statuses.begin()), sizeof(region.mesh_statuses));
-    if (region.size > 0)
-        file.write(reinterpret_cast<const char *>(region.data), region.size);
+        for (int i = 0; i < CHUNK_REGION_SIZE; ++i)
+        {
+            const auto & chunk_meta = region.metas.begin()[i];
 
-    if (!file.good()) std::runtime_error("Writing file failed.");
+            if (chunk_meta.loc == CType::MEMORY)
+            {
+                chunks.push_back({ i, reinterpret_cast<const char *>(chunk_meta.location), chunk_meta.size, chunk_meta.codec });
+                bytes += static_cast<std::size_t>(chunk_meta.size);
+            }
+
+            summaries[i] = chunk_meta.summary;
+        }
+
+        *mesh_statuses = region.mesh_statuses;
+        flushed = 1 - region.current_memory;
+        region.needs_save = false;
+        region.dirty_bytes = 0;
+
+        // chunks stored from now on go to the other block, the collected ones are recycled after the
+        // flush. if the last flush failed, its memory still holds chunks and is kept
+        if (region.memory[flushed].bytesUsed() == 0)
+            region.current_memory = flushed;
+    }
+
+    try
+    {
+        if (!region.file.isOpen())
+            region.file.create(WORLD_ROOT + to_string(region.position), CHUNK_REGION_SIZE, REGION_USER_HEADER_SIZE);
+
+        for (const auto & chunk : chunks)
+            region.file.stageChunk(chunk.index, chunk.data, chunk.size, static_cast<int>(chunk.codec));
+
+        region.file.writeUserHeader(mesh_statuses->begin(), 0, sizeof(Region::MeshStatuses));
+        region.file.writeUserHeader(summaries.get(), REGION_SUMMARIES_OFFSET, sizeof(ChunkSummary) * CHUNK_REGION_SIZE);
+
+        // data first, so a table entry never points to sectors that did not make it to the drive
+        region.file.sync();
+    }
+    catch (const std::runtime_error & error)
+    {
+        Debug::print("Flushing region ", to_string(region.position), " failed: ", error.what());
+
+        // staging may have failed half way, the next try stages everything again
+        if (region.file.isOpen())
+            region.file.discardStaged();
+
+        // try again next time
+        std::unique_lock<std::mutex> lock{ region.write_lock };
+        region.needs_save = true;
+        region.dirty_bytes += bytes;
+
+        return 0;
+    }
+
+    // from now on the chunks are read from the file
+    {
+        std::unique_lock<std::mutex> lock{ region.write_lock };
+
+        region.file.publish();
+
+        for (const auto & chunk : chunks)
+        {
+            auto & chunk_meta = region.metas.begin()[chunk.index];
+
+            if (chunk_meta.loc == CType::MEMORY && reinterpret_cast<const char *>(chunk_meta.location) == chunk.data)
+                chunk_meta.loc = CType::FILE;
+        }
+
+        // readers that looked chunks up before may still decode replaced sectors or flushed memory,
+        // writers that copied into it before the switch still move their chunk out
+        const auto epoch = region.read_epoch;
+        region.read_epoch = 1 - epoch;
+        region.readers_done.wait(lock, [&] { return region.readers[epoch] == 0 && region.memory_writers[flushed] == 0; });
+
+        // every chunk in flushed memory was collected above and is now in the file or replaced by
+        // a newer version in the other block. the units are reused by the next flush
+        region.memory[flushed].reset();
+    }
+
+    try
+    {
+        region.file.sync();
+    }
+    catch (const std::runtime_error & error)
+    {
+        Debug::print("Flushing region ", to_string(region.position), " failed: ", error.what());
+
+        // the chunks are published, but the table may not be on the drive. replaced sectors stay
+        // retired until a later flush gets it there
+        std::unique_lock<std::mutex> lock{ region.write_lock };
+        if (!region.needs_save)
+            region.dirty_since = std::chrono::steady_clock::now();
+        region.needs_save = true;
+
+        return 0;
+    }
+
+    region.file.releaseRetired();
+
+    const auto milliseconds = std::chrono::duration<double, std::milli>{ std::chrono::steady_clock::now() - start }.count();
+
+    ++m_flush_count;
+    m_flush_last_ms = milliseconds;
+    if (milliseconds > m_flush_max_ms.load())
+        m_flush_max_ms = milliseconds;
+
+    return bytes;
+}
+
+//==============================================================================
+World::FlushStatistics World::flushStatistics() const
+{
+    return { m_flush_dirty_regions.load(), m_flush_dirty_bytes.load(), m_flush_count.load(), m_flush_last_ms.load(), m_flush_max_ms.load() };
+}
+
+//==============================================================================
+void World::setBlock(const i32Vec3 block_position, const Block block)
+{
+    setBlocks({ { block_position, block } });
+}
+
+//==============================================================================
+void World::setBlocks(const std::vector<BlockEdit> & edits)
+{
+    if (edits.empty())
+        return;
+
+    EditOperation operation;
+    operation.type = EditOperation::Type::BLOCKS;
+    operation.blocks = edits;
+
+    queueEdit(std::move(operation));
+}
+
+//==============================================================================
+void World::fillBox(const i32Vec3 from_block, const i32Vec3 to_block, const Block block)
+{
+    EditOperation operation;
+    operation.type = EditOperation::Type::FILL_BOX;
+    operation.from = from_block;
+    operation.to = to_block;
+    operation.block = block;
+
+    queueEdit(std::move(operation));
+}
+
+//==============================================================================
+void World::fillSphere(const i32Vec3 center_block, const int radius, const Block block)
+{
+    assert(radius >= 0 && "Negative radius.");
+
+    EditOperation operation;
+    operation.type = EditOperation::Type::FILL_SPHERE;
+    operation.from = center_block - radius;
+    operation.to = center_block + radius + 1;
+    operation.center = center_block;
+    operation.radius = radius;
+    operation.block = block;
+
+    queueEdit(std::move(operation));
+}
+
+//==============================================================================
+void World::replaceBlocks(const i32Vec3 from_block, const i32Vec3 to_block, const Block old_block, const Block new_block)
+{
+    EditOperation operation;
+    operation.type = EditOperation::Type::REPLACE;
+    operation.from = from_block;
+    operation.to = to_block;
+    operation.block = new_block;
+    operation.old_block = old_block;
+
+    queueEdit(std::move(operation));
+}
+
+//==============================================================================
+void World::copyBlocks(const i32Vec3 from_block, const i32Vec3 to_block, const i32Vec3 destination_block)
+{
+    EditOperation operation;
+    operation.type = EditOperation::Type::COPY;
+    operation.from = destination_block;
+    operation.to = destination_block + (to_block - from_block);
+    operation.source = from_block;
+
+    queueEdit(std::move(operation));
+}
+
+//==============================================================================
+World::RayHit World::raycast(const Ray & ray)
+{
+    RayHit hit;
+    raycast(&ray, &hit, 1);
+
+    return hit;
+}
+
+//==============================================================================
+void World::raycast(const Ray * rays, RayHit * hits, const int count)
+{
+    // decoded chunks come from the shared cache, see lookUpChunk()
+    RayChunk chunk;
+
+    for (int i = 0; i < count; ++i)
+        hits[i] = castRay(rays[i], chunk);
+}
+
+//==============================================================================
+World::RayHit World::castRay(const Ray & ray, RayChunk & chunk)
+{
+    return Raycast::cast(ray, CHUNK_SIZES, [&](const i32Vec3 chunk_position, const Block * & blocks)
+    {
+        if (!chunk.valid || !all(chunk.position == chunk_position))
+        {
+            chunk.position = chunk_position;
+            chunk.valid = lookUpChunk(chunk_position, chunk.chunk);
+        }
+
+        blocks = chunk.valid && !chunk.chunk.empty ? chunk.chunk.handle.blocks() : nullptr;
+
+        return chunk.valid;
+    });
+}
+
+//==============================================================================
+World::BlockView World::view(const i32Vec3 from_block, const i32Vec3 to_block)
+{
+    BlockView result;
+    result.m_from_chunk = floor_div(from_block, CHUNK_SIZES);
+    result.m_chunk_counts = max(floor_div(to_block - 1, CHUNK_SIZES) - result.m_from_chunk + 1, i32Vec3{ 0, 0, 0 });
+    result.m_chunks.resize(static_cast<std::size_t>(result.m_chunk_counts[0]) * result.m_chunk_counts[1] * result.m_chunk_counts[2]);
+
+    i32Vec3 offset;
+
+    for (offset[2] = 0; offset[2] < result.m_chunk_counts[2]; ++offset[2])
+        for (offset[1] = 0; offset[1] < result.m_chunk_counts[1]; ++offset[1])
+            for (offset[0] = 0; offset[0] < result.m_chunk_counts[0]; ++offset[0])
+                lookUpChunk(result.m_from_chunk + offset, result.m_chunks[to_index(offset, result.m_chunk_counts)]);
+
+    return result;
+}
+
+//==============================================================================
+const World::BlockView::Chunk * World::BlockView::chunk(const i32Vec3 block_position) const
+{
+    const auto offset = floor_div(block_position, CHUNK_SIZES) - m_from_chunk;
+
+    if (any(offset < i32Vec3{ 0, 0, 0 }) || any(offset >= m_chunk_counts))
+    {
+        assert(false && "Block is outside of the view.");
+        return nullptr;
+    }
+
+    return &m_chunks[to_index(offset, m_chunk_counts)];
+}
+
+//==============================================================================
+bool World::BlockView::known(const i32Vec3 block_position) const
+{
+    const auto * c = chunk(block_position);
+
+    return c != nullptr && c->known;
+}
+
+//==============================================================================
+bool World::BlockView::solid(const i32Vec3 block_position) const
+{
+    const auto * c = chunk(block_position);
+
+    if (c == nullptr || !c->known)
+        return true;
+
+    return !c->empty && !c->handle.blocks()[position_to_index(block_position, CHUNK_SIZES)].isEmpty();
+}
+
+//==============================================================================
+Block World::BlockView::get(const i32Vec3 block_position) const
+{
+    const auto * c = chunk(block_position);
+
+    if (c == nullptr || !c->known || c->empty)
+        return Block{};
+
+    return c->handle.blocks()[position_to_index(block_position, CHUNK_SIZES)];
+}
+
+//==============================================================================
+bool World::lookUpChunk(const i32Vec3 chunk_position, BlockView::Chunk & chunk)
+{
+    chunk.handle.release();
+    chunk.known = false;
+    chunk.empty = false;
+
+    // may run on any thread while regions are loaded, evicted or flushed. the region is found
+    // under the cache's own lock, which is never held across IO or waits. the read keeps the
+    // region and the chunk data from going away while it is decoded
+    Region * region = nullptr;
+    ChunkMeta meta;
+    const char * source = nullptr;
+    int epoch = 0;
+
+    m_regions.find(floor_div(chunk_position, CHUNK_REGION_SIZES), [&](Region & found)
+    {
+        if (beginChunkRead(found, chunk_position, meta, source, epoch))
+            region = &found;
+    });
+
+    if (region == nullptr)
+        return false;
+
+    if (meta.loc != CType::NOWHERE)
+    {
+        chunk.known = true;
+        chunk.empty = meta.summary.allEmpty();
+
+        // the meta is copied again once the cache entry exists. an edit that replaced the chunk before
+        // that found nothing to invalidate, decoding the first copy would cache its old blocks as valid
+        if (!chunk.empty)
+            chunk.handle = m_chunk_cache.get(chunk_position, [&](Block * const blocks)
+            {
+                rereadChunk(*region, chunk_position, meta, source);
+                decodeChunk(meta, source, blocks);
+            });
+    }
+
+    endChunkRead(*region, epoch);
+
+    return chunk.known;
+}
+
+//==============================================================================
+void World::queueEdit(EditOperation && operation)
+{
+    {
+        std::unique_lock<std::mutex> lock{ m_edit_lock };
+
+        // single block edits add up, they stay one operation
+        if (operation.type == EditOperation::Type::BLOCKS && !m_edits.empty() && m_edits.back().type == EditOperation::Type::BLOCKS)
+            m_edits.back().blocks.insert(m_edits.back().blocks.end(), operation.blocks.begin(), operation.blocks.end());
+        else
+            m_edits.push_back(std::move(operation));
+
+        m_jobs_pending = true;
+    }
+
+    m_edit_condition.notify_all();
+}
+
+//==============================================================================
+void World::runPriorityJobs(const i32Vec3 center_mesh, Block * const container)
+{
+    applyEdits(container);
+
+    // all loader threads take part, nearest meshes first
+    while (true)
+    {
+        i32Vec3 mesh_position;
+
+        {
+            std::unique_lock<std::mutex> lock{ m_edit_lock };
+
+            if (m_remesh_queue.empty())
+            {
+                if (m_edits.empty() && !m_edit_batch)
+                    m_jobs_pending = false;
+
+                return;
+            }
+
+            const auto nearest = std::min_element(m_remesh_queue.begin(), m_remesh_queue.end(), [center_mesh](const i32Vec3 & a, const i32Vec3 & b)
+            {
+                return dot(a - center_mesh, a - center_mesh) < dot(b - center_mesh, b - center_mesh);
+            });
+
+            mesh_position = *nearest;
+            *nearest = m_remesh_queue.back();
+            m_remesh_queue.pop_back();
+        }
+
+        remesh(mesh_position);
+    }
+}
+
+//==============================================================================
+void World::applyEdits(Block * const container)
+{
+    while (true)
+    {
+        std::shared_ptr<EditBatch> batch;
+
+        {
+            std::unique_lock<std::mutex> lock{ m_edit_lock };
+            batch = m_edit_batch;
+        }
+
+        if (!batch)
+            batch = startEditBatch(container);
+
+        // nothing queued
+        if (!batch)
+            return;
+
+        const auto chunk_count = batch->chunks.size();
+
+        for (auto i = batch->next_chunk++; i < chunk_count; i = batch->next_chunk++)
+        {
+            applyEditBatch(*batch, batch->chunks[i], container);
+
+            if (++batch->done_chunks == chunk_count)
+                finishEditBatch(*batch);
+        }
+
+        // other threads are still at it, the next batch must not start before they are done
+        if (batch->done_chunks != chunk_count)
+            return;
+    }
+}
+
+//==============================================================================
+std::shared_ptr<World::EditBatch> World::startEditBatch(Block * const container)
+{
+    std::unique_lock<std::mutex> batch_lock{ m_edit_batch_lock };
+
+    const auto byChunk = [](const BlockEdit & a, const BlockEdit & b)
+    {
+        return lessZYX(floor_div(a.position, CHUNK_SIZES), floor_div(b.position, CHUNK_SIZES));
+    };
+
+    while (true)
+    {
+        auto batch = std::make_shared<EditBatch>();
+
+        {
+            std::unique_lock<std::mutex> lock{ m_edit_lock };
+
+            // another thread was faster
+            if (m_edit_batch)
+                return m_edit_batch;
+
+            if (m_edits.empty())
+                return nullptr;
+
+            // a copy reads what the operations before it wrote, so it always starts a batch
+            do
+            {
+                batch->operations.push_back(std::move(m_edits.front()));
+                m_edits.pop_front();
+            }
+            while (!m_edits.empty() && m_edits.front().type != EditOperation::Type::COPY);
+        }
+
+        auto & first = batch->operations.front();
+
+        if (first.type == EditOperation::Type::COPY)
+        {
+            const auto sizes = max(first.to - first.from, i32Vec3{ 0, 0, 0 });
+            first.copied.resize(static_cast<std::size_t>(sizes[0]) * sizes[1] * sizes[2]);
+
+            if (!readBlocks(first.copied.data(), first.source, first.source + sizes, container))
+            {
+                Debug::print("Dropped a copy from ", to_string(first.source), ", its regions are not loaded.");
+                batch->operations.erase(batch->operations.begin());
+            }
+        }
+
+        auto & chunks = batch->chunks;
+
+        for (auto & operation : batch->operations)
+        {
+            if (operation.type == EditOperation::Type::BLOCKS)
+            {
+                // later edits of a block stay behind earlier ones
+                std::stable_sort(operation.blocks.begin(), operation.blocks.end(), byChunk);
+
+                for (const auto & edit : operation.blocks)
+                    chunks.push_back(floor_div(edit.position, CHUNK_SIZES));
+
+                continue;
+            }
+
+            const auto from_chunk = floor_div(operation.from, CHUNK_SIZES);
+            const auto to_chunk = floor_div(operation.to - 1, CHUNK_SIZES);
+            i32Vec3 chunk_position;
+
+            for (chunk_position[2] = from_chunk[2]; chunk_position[2] <= to_chunk[2]; ++chunk_position[2])
+                for (chunk_position[1] = from_chunk[1]; chunk_position[1] <= to_chunk[1]; ++chunk_position[1])
+                    for (chunk_position[0] = from_chunk[0]; chunk_position[0] <= to_chunk[0]; ++chunk_position[0])
+                        chunks.push_back(chunk_position);
+        }
+
+        std::sort(chunks.begin(), chunks.end(), lessZYX);
+        chunks.erase(std::unique(chunks.begin(), chunks.end(), [](const i32Vec3 & a, const i32Vec3 & b) { return all(a == b); }), chunks.end());
+
+        if (!chunks.empty())
+        {
+            std::unique_lock<std::mutex> lock{ m_edit_lock };
+            m_edit_batch = batch;
+            return batch;
+        }
+    }
+}
+
+//==============================================================================
+void World::applyEditBatch(EditBatch & batch, const i32Vec3 chunk_position, Block * const container)
+{
+    if (!m_regions.contains(floor_div(chunk_position, CHUNK_REGION_SIZES)))
+    {
+        Debug::print("Dropped edits in chunk ", to_string(chunk_position), ", its region is not loaded.");
+        return;
+    }
+
+    loadOrGenerateChunk(chunk_position, container);
+
+    const auto chunk_from = chunk_position * CHUNK_SIZES;
+    const auto chunk_to = chunk_from + CHUNK_SIZES;
+
+    // bounds of the blocks that really changed, inclusive
+    bool changed = false;
+    auto changed_from = chunk_to;
+    auto changed_to = chunk_from;
+
+    const auto set = [&](const i32Vec3 position, const Block block)
+    {
+        auto & current = container[position_to_index(position, CHUNK_SIZES)];
+
+        if (current.get() == block.get())
+            return;
+
+        current = block;
+        changed = true;
+        changed_from = min(changed_from, position);
+        changed_to = max(changed_to, position);
+    };
+
+    for (const auto & operation : batch.operations)
+    {
+        if (operation.type == EditOperation::Type::BLOCKS)
+        {
+            const auto range = std::equal_range(operation.blocks.begin(), operation.blocks.end(), BlockEdit{ chunk_from, Block{} }, [](const BlockEdit & a, const BlockEdit & b)
+            {
+                return lessZYX(floor_div(a.position, CHUNK_SIZES), floor_div(b.position, CHUNK_SIZES));
+            });
+
+            for (auto edit = range.first; edit != range.second; ++edit)
+                set(edit->position, edit->block);
+
+            continue;
+        }
+
+        const auto from = max(operation.from, chunk_from);
+        const auto to = min(operation.to, chunk_to);
+        const auto copy_sizes = operation.to - operation.from;
+        const auto radius_squared = operation.radius * operation.radius;
+        i32Vec3 position;
+
+        for (position[2] = from[2]; position[2] < to[2]; ++position[2])
+            for (position[1] = from[1]; position[1] < to[1]; ++position[1])
+                for (position[0] = from[0]; position[0] < to[0]; ++position[0])
+                    switch (operation.type)
+                    {
+                        case EditOperation::Type::FILL_BOX:
+                            set(position, operation.block);
+                            break;
+                        case EditOperation::Type::FILL_SPHERE:
+                            if (dot(position - operation.center, position - operation.center) <= radius_squared)
+                                set(position, operation.block);
+                            break;
+                        case EditOperation::Type::REPLACE:
+                            if (container[position_to_index(position, CHUNK_SIZES)].get() == operation.old_block.get())
+                                set(position, operation.block);
+                            break;
+                        case EditOperation::Type::COPY:
+                            set(position, operation.copied[to_index(position - operation.from, copy_sizes)]);
+                            break;
+                        default:
+                            break;
+                    }
+    }
+
+    if (!changed)
+        return;
+
+    // only the touched chunk is compressed again
+    saveChunkToRegionNew(container, chunk_position, true);
+    m_chunk_cache.invalidate(chunk_position);
+
+    // every mesh that has a changed block inside or in its border
+    const auto from_mesh = floor_div(changed_from - MESH_OFFSETS - MESH_BORDER_REQUIRED_SIZE, MESH_SIZES);
+    const auto to_mesh = floor_div(changed_to - MESH_OFFSETS + MESH_BORDER_REQUIRED_SIZE, MESH_SIZES);
+    i32Vec3 mesh_position;
+
+    std::unique_lock<std::mutex> lock{ batch.meshes_lock };
+
+    for (mesh_position[2] = from_mesh[2]; mesh_position[2] <= to_mesh[2]; ++mesh_position[2])
+        for (mesh_position[1] = from_mesh[1]; mesh_position[1] <= to_mesh[1]; ++mesh_position[1])
+            for (mesh_position[0] = from_mesh[0]; mesh_position[0] <= to_mesh[0]; ++mesh_position[0])
+                batch.meshes.push_back(mesh_position);
+}
+
+//==============================================================================
+void World::finishEditBatch(EditBatch & batch)
+{
+    // all chunks are done, nobody else touches the batch
+    auto & meshes = batch.meshes;
+
+    std::sort(meshes.begin(), meshes.end(), lessZYX);
+    meshes.erase(std::unique(meshes.begin(), meshes.end(), [](const i32Vec3 & a, const i32Vec3 & b) { return all(a == b); }), meshes.end());
+
+    for (const auto & mesh_position : meshes)
+    {
+        // the cached status was decided with the old blocks
+        const auto region_position = floor_div(mesh_position, MESH_REGION_SIZES);
+        if (m_regions.contains(region_position))
+            m_regions[region_position].mesh_statuses[mesh_position] = Region::MStatus::UNKNOWN;
+
+        // meshes built from the old blocks are stale now, even those that are not done yet
+        ++m_mesh_versions[position_to_index(mesh_position, MESH_CONTAINER_SIZES)];
+    }
+
+    {
+        std::unique_lock<std::mutex> lock{ m_edit_lock };
+
+        for (const auto & mesh_position : meshes)
+            if (std::find_if(m_remesh_queue.begin(), m_remesh_queue.end(), [&](const i32Vec3 & m) { return all(m == mesh_position); }) == m_remesh_queue.end())
+                m_remesh_queue.push_back(mesh_position);
+
+        m_edit_batch.reset();
+    }
+
+    // idle threads help with the remeshing
+    m_edit_condition.notify_all();
+}
+
+//==============================================================================
+bool World::readBlocks(Block * const destination, const i32Vec3 from_block, const i32Vec3 to_block, Block * const container)
+{
+    const auto sizes = to_block - from_block;
+    const auto from_chunk = floor_div(from_block, CHUNK_SIZES);
+    const auto to_chunk = floor_div(to_block - 1, CHUNK_SIZES);
+    i32Vec3 chunk_position;
+
+    // nothing is read unless all of it can be
+    for (chunk_position[2] = from_chunk[2]; chunk_position[2] <= to_chunk[2]; ++chunk_position[2])
+        for (chunk_position[1] = from_chunk[1]; chunk_position[1] <= to_chunk[1]; ++chunk_position[1])
+            for (chunk_position[0] = from_chunk[0]; chunk_position[0] <= to_chunk[0]; ++chunk_position[0])
+                if (!m_regions.contains(floor_div(chunk_position, CHUNK_REGION_SIZES)))
+                    return false;
+
+    for (chunk_position[2] = from_chunk[2]; chunk_position[2] <= to_chunk[2]; ++chunk_position[2])
+        for (chunk_position[1] = from_chunk[1]; chunk_position[1] <= to_chunk[1]; ++chunk_position[1])
+            for (chunk_position[0] = from_chunk[0]; chunk_position[0] <= to_chunk[0]; ++chunk_position[0])
+            {
+                loadOrGenerateChunk(chunk_position, container);
+
+                const auto chunk_from = chunk_position * CHUNK_SIZES;
+                const auto from = max(from_block, chunk_from);
+                const auto to = min(to_block, chunk_from + CHUNK_SIZES);
+                i32Vec3 position;
+
+                for (position[2] = from[2]; position[2] < to[2]; ++position[2])
+                    for (position[1] = from[1]; position[1] < to[1]; ++position[1])
+                        for (position[0] = from[0]; position[0] < to[0]; ++position[0])
+                            destination[to_index(position - from_block, sizes)] = container[position_to_index(position, CHUNK_SIZES)];
+            }
+
+    return true;
+}
+
+//==============================================================================
+void World::loadOrGenerateChunk(const i32Vec3 chunk_position, Block * const container)
+{
+    auto & region = m_regions[floor_div(chunk_position, CHUNK_REGION_SIZES)];
+    CType location;
+
+    {
+        std::unique_lock<std::mutex> lock{ region.write_lock };
+        location = region.metas[chunk_position].loc;
+    }
+
+    // not generated yet, edits apply to the terrain that will be there
+    if (location == CType::NOWHERE)
+    {
+        const auto from = chunk_position * CHUNK_SIZES;
+        const auto to = from + CHUNK_SIZES;
+
+        Block uniform_value;
+        if (Terrain::uniform(from, to, WORLD_GENERATOR, uniform_value))
+            std::fill(container, container + CHUNK_SIZE, uniform_value);
+        else
+            generateChunkNew(container, from, to, WORLD_GENERATOR);
+    }
+    else
+    {
+        loadChunkToChunkContainerNew(chunk_position, container);
+    }
+}
+
+//==============================================================================
+void World::remesh(const i32Vec3 mesh_position)
+{
+    // meshes that are not loaded get the new blocks when the walk reaches them
+    if (m_mesh_loaded[mesh_position] != Status::LOADED)
+        return;
+
+    // the chunks under the mesh, their regions are gone if the mesh is far away
+    const auto from_block = mesh_position * MESH_SIZES + MESH_OFFSETS;
+    const auto chunk_position_from = floor_div(from_block, CHUNK_SIZES);
+    const auto chunk_position_to = floor_div(from_block + MESH_SIZES - 1, CHUNK_SIZES);
+    i32Vec3 position;
+
+    for (position[2] = chunk_position_from[2]; position[2] <= chunk_position_to[2]; ++position[2])
+        for (position[1] = chunk_position_from[1]; position[1] <= chunk_position_to[1]; ++position[1])
+            for (position[0] = chunk_position_from[0]; position[0] <= chunk_position_to[0]; ++position[0])
+                if (!m_regions.contains(floor_div(position, CHUNK_REGION_SIZES)))
+                    return;
+
+    const auto & version = m_mesh_versions[position_to_index(mesh_position, MESH_CONTAINER_SIZES)];
+    const auto started_version = version.load();
+
+    const auto mesh = generateMeshNew(mesh_position);
+
+    // any outcome but "still empty" pushes a command, reserve it before locking
+    if (!reserveCommand())
+        return;
+
+    std::unique_lock<std::mutex> loaded_lock{ m_loaded_meshes_lock };
+
+    const auto loaded = std::find_if(m_loaded_meshes.begin(), m_loaded_meshes.end(), [&](const MeshMeta & m) { return all(m.position == mesh_position); });
+
+    // edited again meanwhile, a newer job for this mesh is queued
+    // or the walk is still publishing it, it checks the version itself
+    if (started_version != version.load() || loaded == m_loaded_meshes.end())
+    {
+        loaded_lock.unlock();
+        releaseCommand();
+        return;
+    }
+
+    const bool was_empty = loaded->empty;
+    const bool empty = mesh.empty();
+
+    loaded->empty = empty;
+    m_regions[floor_div(mesh_position, MESH_REGION_SIZES)].mesh_statuses[mesh_position] = empty ? Region::MStatus::EMPTY : Region::MStatus::NON_EMPTY;
+
+    if (empty && !was_empty)
+        pushCommand(Command::Type::REMOVE, mesh_position, mesh);
+    else if (!empty)
+        pushCommand(was_empty ? Command::Type::UPLOAD : Command::Type::REPLACE, mesh_position, mesh);
+    else
+    {
+        loaded_lock.unlock();
+        releaseCommand();
+    }
+}
+
+//==============================================================================
+bool World::reserveCommand()
+{
+    std::unique_lock<std::mutex> lock{ m_ring_buffer_lock };
+
+    // exit must not leave workers waiting for a render thread that stopped popping
+    m_commands_space.wait(lock, [this] { return m_reserved_commands < COMMAND_BUFFER_SIZE - 1 || m_quit; });
+
+    if (m_quit)
+        return false;
+
+    ++m_reserved_commands;
+
+    return true;
+}
+
+//==============================================================================
+bool World::tryReserveCommand()
+{
+    std::unique_lock<std::mutex> lock{ m_ring_buffer_lock };
+
+    if (m_reserved_commands >= COMMAND_BUFFER_SIZE - 1)
+        return false;
+
+    ++m_reserved_commands;
+
+    return true;
+}
+
+//==============================================================================
+void World::releaseCommand()
+{
+    {
+        std::unique_lock<std::mutex> lock{ m_ring_buffer_lock };
+        assert(m_reserved_commands > 0 && "Nothing reserved.");
+        --m_reserved_commands;
+    }
+
+    m_commands_space.notify_one();
+}
+
+//==============================================================================
+void World::pushCommand(const Command::Type type, const i32Vec3 mesh_position, const std::vector<Vertex> & mesh)
+{
+    std::unique_lock<std::mutex> lock { m_ring_buffer_lock };
+
+    auto * command = m_commands.initPush();
+
+    // the reservation keeps a slot free, so this never waits
+    assert(command != nullptr && "Command pushed without a reservation.");
+
+    command->type = type;
+    command->index = position_to_index(mesh_position, MESH_CONTAINER_SIZES);
+    command->position = mesh_position;
+    command->mesh = mesh;
+
+    m_commands.commitPush();
+}
+
+//==============================================================================
+void World::convertLegacyRegion(const std::string & file_name)
+{
+    // NEW_REGION_FORMAT before sectors: size | metas | mesh_statuses | data
+    struct LegacyChunkMeta { int size; CType loc; struct { int offset_n; Bytef * location; }; };
+
+    Debug::print("Converting region ", file_name);
+
+    std::ifstream file{ file_name, std::ifstream::binary };
+
+    int size = 0;
+    std::unique_ptr<LegacyChunkMeta[]> metas{ std::make_unique<LegacyChunkMeta[]>(CHUNK_REGION_SIZE) };
+    std::unique_ptr<char[]> mesh_statuses{ std::make_unique<char[]>(REGION_MESH_STATUSES_SIZE) };
+    std::unique_ptr<ChunkSummary[]> summaries{ std::make_unique<ChunkSummary[]>(CHUNK_REGION_SIZE) };
+
+    file.read(reinterpret_cast<char *>(&size), sizeof(size));
+    file.read(reinterpret_cast<char *>(metas.get()), sizeof(LegacyChunkMeta) * CHUNK_REGION_SIZE);
+    file.read(mesh_statuses.get(), REGION_MESH_STATUSES_SIZE);
+
+    if (!file.good() || size < 0) throw std::runtime_error("Reading legacy region " + file_name + " failed.");
+
+    std::unique_ptr<char[]> data{ std::make_unique<char[]>(static_cast<std::size_t>(size)) };
+    file.read(data.get(), size);
+
+    if (!file.good()) throw std::runtime_error("Reading legacy region " + file_name + " failed.");
+
+    // convert to temporary file first, so a failed conversion does not lose the old file
+    const std::string converted_name = file_name + ".converting";
+    {
+        RegionFile converted;
+        converted.create(converted_name, CHUNK_REGION_SIZE, REGION_USER_HEADER_SIZE);
+
+        for (int i = 0; i < CHUNK_REGION_SIZE; ++i)
+        {
+            const auto & meta = metas[i];
+
+            if (meta.loc != CType::FILE || meta.size <= 0)
+                continue;
+
+            if (meta.offset_n < 0 || meta.offset_n + meta.size > size)
+                throw std::runtime_error("Legacy region " + file_name + " is corrupted.");
+
+            converted.writeChunk(i, data.get() + meta.offset_n, meta.size, static_cast<int>(Codec::ZLIB));
+            summaries[i] = summarizeStoredChunk(Codec::ZLIB, data.get() + meta.offset_n, meta.size);
+        }
+
+        converted.writeUserHeader(mesh_statuses.get(), 0, REGION_MESH_STATUSES_SIZE);
+        converted.writeUserHeader(summaries.get(), REGION_SUMMARIES_OFFSET, sizeof(ChunkSummary) * CHUNK_REGION_SIZE);
+    }
+
+    if (std::rename(converted_name.c_str(), file_name.c_str()) != 0)
+        throw std::runtime_error("Replacing legacy region " + file_name + " failed.");
+}
+
+//==============================================================================
+void World::upgradeRegion(const std::string & file_name)
+{
+    // sector format with mesh statuses only in the user header. chunk summaries are computed once here
+    Debug::print("Adding chunk summaries to region ", file_name);
+
+    const std::string converted_name = file_name + ".converting";
+    {
+        RegionFile file;
+        file.open(file_name, CHUNK_REGION_SIZE, REGION_MESH_STATUSES_SIZE);
+
+        std::unique_ptr<char[]> mesh_statuses{ std::make_unique<char[]>(REGION_MESH_STATUSES_SIZE) };
+        std::unique_ptr<ChunkSummary[]> summaries{ std::make_unique<ChunkSummary[]>(CHUNK_REGION_SIZE) };
+        file.readUserHeader(mesh_statuses.get(), 0, REGION_MESH_STATUSES_SIZE);
+
+        RegionFile converted;
+        converted.create(converted_name, CHUNK_REGION_SIZE, REGION_USER_HEADER_SIZE);
+
+        for (int i = 0; i < CHUNK_REGION_SIZE; ++i)
+        {
+            const auto size = file.chunkSize(i);
+
+            if (size == 0)
+                continue;
+
+            const auto tag = file.chunkTag(i);
+            converted.writeChunk(i, file.chunk(i), size, tag);
+            summaries[i] = summarizeStoredChunk(static_cast<Codec>(tag), file.chunk(i), size);
+        }
+
+        converted.writeUserHeader(mesh_statuses.get(), 0, REGION_MESH_STATUSES_SIZE);
+        converted.writeUserHeader(summaries.get(), REGION_SUMMARIES_OFFSET, sizeof(ChunkSummary) * CHUNK_REGION_SIZE);
+    }
+
+    if (std::rename(converted_name.c_str(), file_name.c_str()) != 0)
+        throw std::runtime_error("Replacing region " + file_name + " failed.");
+}
+
+//==============================================================================
+ChunkSummary World::summarizeStoredChunk(const Codec codec, const char * const data, const int size)
+{
+    // unknown codec or broken data: summary that claims nothing
+    if (!ChunkCodec::available(codec))
+        return ChunkSummary{};
+
+    std::unique_ptr<Block[]> blocks{ std::make_unique<Block[]>(CHUNK_SIZE) };
+
+    if (!ChunkCodec::decompress(codec, reinterpret_cast<char *>(blocks.get()), CHUNK_DATA_SIZE, data, static_cast<std::size_t>(size), CHUNK_SIZES))
+        return ChunkSummary{};
+
+    return ChunkSummary::of(blocks.get(), CHUNK_SIZES);
+}
+
+//==============================================================================
+bool World::meshProvenEmpty(const i32Vec3 mesh_position) const
+{
+    // the chunks under a mesh also contain the border blocks needed for meshing, so
+    // if all of them are empty or all of them are solid, there can't be any face
+    const auto from_block = mesh_position * CHUNK_SIZES + MESH_OFFSETS - MESH_BORDER_REQUIRED_SIZE;
+    const auto to_block = from_block + CHUNK_SIZES + MESH_BORDER_REQUIRED_SIZE * 2;
+
+    const auto chunk_position_from = floor_div(from_block, CHUNK_SIZES);
+    const auto chunk_position_to = floor_div(to_block - 1, CHUNK_SIZES);
+
+    bool all_empty = true, all_solid = true;
+    i32Vec3 position;
+
+    for (position[2] = chunk_position_from[2]; position[2] <= chunk_position_to[2]; ++position[2])
+        for (position[1] = chunk_position_from[1]; position[1] <= chunk_position_to[1]; ++position[1])
+            for (position[0] = chunk_position_from[0]; position[0] <= chunk_position_to[0]; ++position[0])
+            {
+                const auto & region = m_regions[floor_div(position, CHUNK_REGION_SIZES)];
+                const auto summary = region.metas[position].summary;
+
+                all_empty = all_empty && summary.allEmpty();
+                all_solid = all_solid && summary.allSolid();
+
+                if (!all_empty && !all_solid)
+                    return false;
+            }
+
+    return true;
 }
 
 /*
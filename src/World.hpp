@@ -2,22 +2,35 @@
 
 #define NEW_REGION_FORMAT
 
+#include "AsyncIO.hpp"
+#include "ChunkCache.hpp"
+#include "ChunkCodec.hpp"
+#include "ChunkSummary.hpp"
+#include "ColumnCache.hpp"
+#include "ConcurrentMemoryBlock.hpp"
 #include "MemoryBlock.hpp"
+#include "RegionCache.hpp"
+#include "RegionFile.hpp"
+#include "Raycast.hpp"
 #include "RingBufferSingleProducerSingleConsumer.hpp"
 #include "SparseMap.hpp"
 #include "Algebra.hpp"
 #include "Block.hpp"
 #include "SphereIterator.hpp"
+#include "Terrain.hpp"
 #include <string>
 #include <vector>
 #include <GL/gl3w.h>
-#include <zlib.h> // TODO: checkout other compression libraries that are faster
+#include <zlib.h>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
 #include <atomic>
+#include <chrono>
 #include <stack>
 #include <queue>
+#include <deque>
+#include <memory>
 #include "ModTable.hpp"
 #include "ThreadBarrier.hpp"
 #include "Settings.hpp"
@@ -82,8 +95,7 @@ struct MeshMeta { i32Vec3 position; bool empty; };
 
 #ifdef NEW_REGION_FORMAT
 enum class CType { MEMORY, FILE, NOWHERE }; // also for determining what's in the union
-//struct ChunkMeta { int size; CType loc; union { int offset_n; Bytef * location; }; };
-struct ChunkMeta { int size; CType loc; struct { int offset_n; Bytef * location; }; }; // Unions could also work and would use less space, but i had few minor bugs with unions and will for now fix them by replacing union with struct
+struct ChunkMeta { int size; CType loc; Codec codec; ChunkSummary summary; Bytef * location; }; // location only used for MEMORY. FILE chunks are looked up in the region file by index
 #else
 struct ChunkMeta { int size; int offset; };
 #endif
@@ -92,7 +104,7 @@ enum class Status : char { UNLOADED, LOADED, CHECKED };
 
 struct Command
 {
-    enum class Type : int { REMOVE, UPLOAD };
+    enum class Type : int { REMOVE, UPLOAD, REPLACE }; // REPLACE reuses the buffers of a loaded mesh
     Type type;
     int index;
     i32Vec3 position;
@@ -101,8 +113,6 @@ struct Command
 
 struct MeshWPos { Mesh mesh; i32Vec3 position; };
 
-enum class WorldType { SINE, SMALL_BLOCK, FLOOR, SIMPLEX_2D, EMPTY };
-
 //==============================================================================
 class World
 {
@@ -110,7 +120,65 @@ public:
     World(); // TODO: refactor
     ~World(); // TODO: refactor
 
-    void draw(const i32Vec3 new_center, const f32Vec4 frustum_planes[6], const GLint offset_uniform);
+    // render thread, once per frame in this order. the camera sits near origin and the view
+    // projection matrix (and so the frustum) is relative to it, so floats stay small far out
+    void update(const i32Vec3 new_center); // executes loader commands
+    void cull(const f32Vec4 frustum_planes[6], const i32Vec3 origin);
+    void draw(const GLint offset_uniform, const i32Vec3 origin);
+
+#ifdef NEW_REGION_FORMAT
+    // background flushing of dirty regions, can be read from any thread
+    struct FlushStatistics { int dirty_regions; std::size_t dirty_bytes; long long flushed_regions; double last_latency_ms, max_latency_ms; };
+    FlushStatistics flushStatistics() const;
+
+    // any thread. edits are applied by the loader threads ahead of the sphere walk, in the order
+    // they were made, then the touched meshes are rebuilt. edits outside of the loaded regions are dropped
+    struct BlockEdit { i32Vec3 position; Block block; };
+    void setBlock(const i32Vec3 block_position, const Block block);
+    void setBlocks(const std::vector<BlockEdit> & edits); // applied together, each chunk is recompressed once
+
+    // volume edits, boxes are [from, to). consecutive ones are applied together and the chunks
+    // are spread over all loader threads
+    void fillBox(const i32Vec3 from_block, const i32Vec3 to_block, const Block block);
+    void fillSphere(const i32Vec3 center_block, const int radius, const Block block);
+    void replaceBlocks(const i32Vec3 from_block, const i32Vec3 to_block, const Block old_block, const Block new_block);
+    void copyBlocks(const i32Vec3 from_block, const i32Vec3 to_block, const i32Vec3 destination_block); // box moves to destination_block, may overlap
+
+    // any thread. first solid block along the ray, by voxel traversal. chunks that are not generated
+    // or not loaded are unknown, the ray stops there without a hit. empty chunks are crossed in one step
+    using Ray = Raycast::Ray;
+    using RayHit = Raycast::Hit;
+    RayHit raycast(const Ray & ray);
+    void raycast(const Ray * rays, RayHit * hits, const int count); // coherent rays share decoded chunks
+
+    // any thread. read only view of the blocks in a box, for queries that need many of them. the
+    // chunks are looked up once when the view is made and stay readable while it lives.
+    // blocks of chunks that are not generated or not loaded are unknown
+    class BlockView
+    {
+    public:
+        bool known(const i32Vec3 block_position) const;
+        bool solid(const i32Vec3 block_position) const; // unknown blocks are solid
+        Block get(const i32Vec3 block_position) const; // empty if unknown
+
+    private:
+        friend class World;
+
+        struct Chunk
+        {
+            bool known{ false }, empty{ false };
+            ChunkCache::Handle handle; // only set for known chunks that are not empty
+        };
+
+        const Chunk * chunk(const i32Vec3 block_position) const; // nullptr outside of the box
+
+        i32Vec3 m_from_chunk, m_chunk_counts;
+        std::vector<Chunk> m_chunks;
+
+    };
+
+    BlockView view(const i32Vec3 from_block, const i32Vec3 to_block); // [from_block, to_block)
+#endif
 
 private:
     //==============================================================================
@@ -123,6 +191,8 @@ private:
             CSIZE{ 16 },
             MSIZE{ 16 },
             MCSIZE{ (REDISTANCE * 2) + 1 + 8 }, // + any number
+            MGSIZE{ 8 }, // meshes per culling group side
+            MGCSIZE{ ceil_int_div(MCSIZE, MGSIZE) + 1 },
             MESH_BORDER_REQUIRED_SIZE{ 1 },
             MOFF{ CSIZE / 2 },
             CRSIZE{ ceil_int_div(512, CSIZE) },
@@ -148,7 +218,12 @@ private:
 
     static constexpr i32Vec3 MESH_OFFSETS{ MOFF, MOFF, MOFF };
 
+    static constexpr i32Vec3 MESH_GROUP_SIZES{ MGSIZE, MGSIZE, MGSIZE };
+    static constexpr i32Vec3 MESH_GROUP_CONTAINER_SIZES{ MGCSIZE, MGCSIZE, MGCSIZE };
+    static constexpr int MESH_GROUP_CAPACITY{ product_constexpr(MESH_GROUP_SIZES) };
+
     static constexpr int CHUNK_SIZE{ product_constexpr(CHUNK_SIZES) };
+    static constexpr int CHUNK_REGION_SIZE{ product_constexpr(CHUNK_REGION_SIZES) };
     static constexpr int CHUNK_CONTAINER_SIZE{ product_constexpr(CHUNK_CONTAINER_SIZES) };
     static constexpr int MESH_CONTAINER_SIZE{ product_constexpr(MESH_CONTAINER_SIZES) };
 
@@ -160,6 +235,9 @@ private:
 
     static_assert(sizeof(Bytef) == sizeof(char), "Assuming that.");
     static constexpr int CHUNK_DATA_SIZE{ sizeof(Block) * CHUNK_SIZE };
+    static constexpr Codec CHUNK_CODEC{ WORLD_CHUNK_CODEC }; // new chunks, existing chunks keep theirs
+    static constexpr int PALETTE_MAX_BITS{ 2 }; // chunks with up to 4 block types are stored as palette instead of CHUNK_CODEC
+    static constexpr std::size_t PALETTE_MAX_SIZE{ 2 + (1 << PALETTE_MAX_BITS) + CHUNK_DATA_SIZE * PALETTE_MAX_BITS / 8 };
 
     static constexpr int COMMAND_BUFFER_SIZE{ 128 };
     static constexpr int SLEEP_MS{ 300 };
@@ -171,8 +249,18 @@ private:
 
     static constexpr int MESH_CACHE_DATA_SIZE_FACTOR{ 4096 * 64 };
     static constexpr int REGION_DATA_SIZE_FACTOR{ CHUNK_DATA_SIZE * 128 };
+    // region file user header: mesh statuses, then one summary per chunk
+    static constexpr std::size_t REGION_MESH_STATUSES_SIZE{ sizeof(ModTable<char, int, MRSIZE, MRSIZE, MRSIZE>) };
+    static constexpr std::size_t REGION_SUMMARIES_OFFSET{ REGION_MESH_STATUSES_SIZE };
+    static constexpr std::size_t REGION_USER_HEADER_SIZE{ REGION_SUMMARIES_OFFSET + sizeof(ChunkSummary) * CHUNK_REGION_SIZE };
 
     static constexpr int THREAD_COUNT{ 3 }; // locking issues. multi threads are not working, because of reallocating region data?
+    static constexpr int IO_THREAD_COUNT{ 2 }; // region saving and prefetching (and blocking IO if there is no io_uring)
+    static constexpr int CHUNK_CACHE_CAPACITY{ 4096 }; // decoded chunks (16 MiB), a few shells of the sphere iterator
+    static constexpr int COLUMN_CACHE_CAPACITY{ 1024 }; // chunk columns (2.3 MiB), twice the columns in loading distance
+    static constexpr std::size_t REGION_CACHE_BUDGET{ WORLD_REGION_CACHE_BUDGET };
+    static constexpr int FLUSH_INTERVAL_MS{ 5000 }; // dirty regions are written at least this often
+    static constexpr std::size_t FLUSH_BYTES_PER_TICK{ 8 * 1024 * 1024 }; // rest waits for the next interval
 
 public:
     static_assert(CSIZE == 16 && MSIZE == 16 && MOFF == 8, "Temporary.");
@@ -206,6 +294,8 @@ private:
     ThreadBarrier m_barrier{ THREAD_COUNT };
     UniqueBarrier m_ugly_hacky_thingy{ THREAD_COUNT };
     std::mutex m_ring_buffer_lock; // TODO: my idea was to create a lock free system, but this might be okay
+    std::condition_variable m_commands_space; // signaled when the render thread frees slots or on exit
+    int m_reserved_commands{ 0 }; // slots reserved or queued, guarded by m_ring_buffer_lock
 
     // TODO: Maybe replace by array and size counter. Max possible size should be equal to MESH_CONTAINER_SIZE_X * MESH_CONTAINER_SIZE_Y * MESH_CONTAINER_SIZE_Z, but is overkill.
     std::vector<MeshMeta> m_loaded_meshes; // contains all loaded meshes
@@ -213,22 +303,110 @@ private:
 
     struct Region
     {
-        i32Vec3 position;
-        ModTable<ChunkMeta, int, CHUNK_REGION_SIZES[0], CHUNK_REGION_SIZES[1], CHUNK_REGION_SIZES[2]> metas;
         enum class MStatus : char { UNKNOWN, EMPTY, NON_EMPTY }; // could be reduced to bitmap (2 bits per mesh)
-        ModTable<MStatus, int, MESH_REGION_SIZES[0], MESH_REGION_SIZES[1], MESH_REGION_SIZES[2]> mesh_statuses;
+        using Metas = ModTable<ChunkMeta, int, CHUNK_REGION_SIZES[0], CHUNK_REGION_SIZES[1], CHUNK_REGION_SIZES[2]>;
+        using MeshStatuses = ModTable<MStatus, int, MESH_REGION_SIZES[0], MESH_REGION_SIZES[1], MESH_REGION_SIZES[2]>;
+
+        i32Vec3 position;
+        Metas metas;
+        MeshStatuses mesh_statuses;
 #ifdef NEW_REGION_FORMAT
         // yes, use both
-        MemoryBlock<> data_memory;
-        Bytef * data; // TODO: replace pointer with RAII mechanism
+        // chunks are appended to memory[current_memory] without write_lock. a flush switches to the other
+        // block, collects the chunks of the old one and recycles it when it is done
+        ConcurrentMemoryBlock<> memory[2];
+        std::atomic_int current_memory{ 0 };
+        std::atomic_int memory_writers[2]{ { 0 }, { 0 } }; // threads that may still copy chunks into or out of a block
+        RegionFile file; // saved chunks, read in place
+        std::chrono::steady_clock::time_point dirty_since; // the fields below are guarded by write_lock, except flushing (m_flush_lock)
+        std::size_t dirty_bytes; // chunks not yet on the drive
+        bool flushing;
+        // threads decoding chunk data outside of write_lock, counted per epoch. a flush switches
+        // the epoch after publishing and waits for the old one, then replaced data may be reused
+        int readers[2]{ 0, 0 };
+        int read_epoch{ 0 };
+        std::condition_variable readers_done;
+        bool ready{ false }; // filled in by loadRegionNew(), guarded by write_lock. threads outside the loader may find it earlier
 #else
         Bytef * data; // TODO: replace pointer with RAII mechanism
-#endif
         int size, container_size;
+#endif
         std::mutex write_lock;
         bool needs_save;
     };
+#ifdef NEW_REGION_FORMAT
+    // sizeof(Region) plus chunk data in memory. mapped region files are page cache and not counted
+    RegionCache<Region> m_regions{ REGION_CACHE_BUDGET, [](const Region & region) { return region.memory[0].bytesReserved() + region.memory[1].bytesReserved(); } };
+    std::vector<i32Vec3> m_pinned_regions; // regions of the current sphere layer, only touched by the thread loading regions
+#else
     ModTable<Region, int, CHUNK_REGION_CONTAINER_SIZES[0], CHUNK_REGION_CONTAINER_SIZES[1], CHUNK_REGION_CONTAINER_SIZES[2]> m_regions;
+#endif
+
+#ifdef NEW_REGION_FORMAT
+    // evicted region that is written to the drive by an IO thread
+    struct PendingSave
+    {
+        i32Vec3 position;
+        Region::Metas metas;
+        Region::MeshStatuses mesh_statuses;
+        ConcurrentMemoryBlock<> memory[2];
+        RegionFile file;
+    };
+    AsyncIO m_io{ IO_THREAD_COUNT };
+    std::vector<i32Vec3> m_pending_saves; // a region must not be loaded while it is still being saved
+    std::mutex m_pending_saves_lock;
+    std::condition_variable m_pending_saves_condition;
+    std::vector<i32Vec3> m_prefetched_regions; // only touched by the thread loading regions
+    ChunkCache m_chunk_cache{ CHUNK_SIZE, CHUNK_CACHE_CAPACITY };
+    ColumnCache m_column_cache{ COLUMN_CACHE_CAPACITY }; // terrain noise of chunk columns, shared by the chunks stacked in them
+
+    // dirty regions are written in place periodically, so a crash loses at most FLUSH_INTERVAL_MS of work
+    std::thread m_flusher;
+    std::mutex m_regions_lock; // loading and evicting regions vs. the flusher looking for dirty ones
+    std::mutex m_flush_lock;
+    std::condition_variable m_flush_condition;
+    bool m_flush_quit{ false };
+    std::atomic<int> m_flush_dirty_regions{ 0 };
+    std::atomic<std::size_t> m_flush_dirty_bytes{ 0 };
+    std::atomic<long long> m_flush_count{ 0 };
+    std::atomic<double> m_flush_last_ms{ 0.0 };
+    std::atomic<double> m_flush_max_ms{ 0.0 };
+
+    struct EditOperation
+    {
+        enum class Type : char { BLOCKS, FILL_BOX, FILL_SPHERE, REPLACE, COPY };
+
+        Type type;
+        i32Vec3 from, to; // bounds of what may change
+        Block block, old_block;
+        i32Vec3 center; int radius{ 0 }; // FILL_SPHERE
+        i32Vec3 source; // COPY, from of the source box
+        std::vector<BlockEdit> blocks; // BLOCKS, sorted by chunk when the batch starts
+        std::vector<Block> copied; // COPY, the source box, read when the batch starts
+    };
+
+    // consecutive operations applied to each chunk in one go. loader threads take chunks until
+    // none are left, the last one done queues the remeshes. batches do not overlap in time
+    struct EditBatch
+    {
+        std::vector<EditOperation> operations;
+        std::vector<i32Vec3> chunks;
+        std::atomic<std::size_t> next_chunk{ 0 };
+        std::atomic<std::size_t> done_chunks{ 0 };
+        std::mutex meshes_lock;
+        std::vector<i32Vec3> meshes; // touched ones, may contain duplicates
+    };
+
+    // block edits and the meshes they touched. both are worked off before the next sphere walk task
+    std::deque<EditOperation> m_edits;
+    std::shared_ptr<EditBatch> m_edit_batch; // the one being applied, if any
+    std::vector<i32Vec3> m_remesh_queue; // nearest to the center first
+    std::mutex m_edit_lock; // m_edits, m_edit_batch, m_remesh_queue
+    std::mutex m_edit_batch_lock; // one thread starts the next batch
+    std::condition_variable m_edit_condition; // wakes up idle loader threads
+    std::atomic<bool> m_jobs_pending{ false };
+    std::unique_ptr<std::atomic<unsigned>[]> m_mesh_versions{ std::make_unique<std::atomic<unsigned>[]>(MESH_CONTAINER_SIZE) }; // incremented on every edit, a mesh built from older blocks is stale
+#endif
 
     [[deprecated]]
     struct MeshCache
@@ -249,6 +427,16 @@ private:
     std::stack<UnusedBuffer> m_unused_buffers;
     //iVec3 m_reference_center;
     SparseMap<MeshWPos, std::remove_const<decltype(MESH_CONTAINER_SIZE)>::type, MESH_CONTAINER_SIZE> m_meshes;
+    std::vector<const MeshWPos *> m_visible_meshes; // result of cull()
+
+    // loaded meshes grouped for culling, a group is tested first and its meshes only if it crosses the frustum
+    struct MeshGroup
+    {
+        i32Vec3 position{ 0, 0, 0 };
+        std::vector<int> meshes; // indices into m_meshes
+        int last_out_plane{ 0 }; // plane that rejected the group last, tested first
+    };
+    ModTable<MeshGroup, int, MESH_GROUP_CONTAINER_SIZES[0], MESH_GROUP_CONTAINER_SIZES[1], MESH_GROUP_CONTAINER_SIZES[2]> m_mesh_groups;
 
     // shared / synchronization data
     RingBufferSingleProducerSingleConsumer<Command, COMMAND_BUFFER_SIZE> m_commands;
@@ -261,7 +449,9 @@ private:
 
     //==============================================================================
     // functions
-    static bool meshInFrustum(const f32Vec4 planes[6], const i32Vec3 mesh_offset); // TODO: refactor
+    enum class Containment { OUTSIDE, CROSSING, INSIDE };
+    static Containment boxInFrustum(const f32Vec4 planes[6], const f32Vec3 from, const float size, int & first_plane, unsigned & crossing_planes);
+    static void boxesInFrustum(const f32Vec4 planes[6], const unsigned plane_mask, const float size, const float * x, const float * y, const float * z, const int count, bool * visible);
 
     // renderer functions
     void executeRendererCommands(const int max_command_count);
@@ -270,14 +460,21 @@ private:
     std::vector<Vertex> loadMesh(const i32Vec3 mesh_position);
     void exitLoaderThread();
     void loadChunkToChunkContainerOld(const i32Vec3 chunk_position);
-    void loadChunkToChunkContainerNew(const i32Vec3 chunk_position, Block * const chunks, i32Vec3 * const chunk_meta);
+    void loadChunkToChunkContainerNew(const i32Vec3 chunk_position, Block * const chunk);
     void saveRegionToDriveNew(const i32Vec3 region_position);
+    static void writeRegion(const i32Vec3 region_position, RegionFile & file, Region::Metas & metas, const Region::MeshStatuses & mesh_statuses);
+    void saveRegionInBackground(Region & region);
+    void waitForPendingSave(const i32Vec3 region_position);
+    void prefetchRegions(const i32Vec3 from_chunk, const i32Vec3 to_chunk);
+    void flushLoop();
+    void flushDirtyRegions();
+    std::size_t flushRegion(Region & region); // returns bytes written
     void saveRegionToDriveOld(const i32Vec3 region_position);
     void saveMeshCacheToDrive(const i32Vec3 mesh_cache_position);
     void loadChunkRange(const i32Vec3 from_block, const i32Vec3 to_block);
     template<typename GetBlock>
     std::vector<Vertex> generateMesh(const i32Vec3 from_block, const i32Vec3 to_block, GetBlock blockGet);
-    std::vector<Vertex> generateMeshNew(const i32Vec3 mesh_position, /*const iVec3 chunk_container_size,*/ Block * const chunks, i32Vec3 * const chunk_metas);
+    std::vector<Vertex> generateMeshNew(const i32Vec3 mesh_position);
     std::vector<Vertex> generateMeshOld(const i32Vec3 from_block, const i32Vec3 to_block);
     class BlockGetter // this is temporary, to reduce boilerplate (duplicating generateMesh)
     {
@@ -295,18 +492,49 @@ private:
     void loadMeshCache(const i32Vec3 mesh_cache_position);
     void loadRegionOld(const i32Vec3 region_position);
     void loadRegionNew(const i32Vec3 region_position);
+    static void convertLegacyRegion(const std::string & file_name);
     void saveChunkToRegionOld(const i32Vec3 chunk_position);
-    void saveChunkToRegionNew(const Block * const source, const i32Vec3 chunk_position);
+    bool saveChunkToRegionNew(const Block * const source, const i32Vec3 chunk_position, const bool replace = false); // false if the chunk exists and replace is not set
+    void runPriorityJobs(const i32Vec3 center_mesh, Block * const container);
+    // the chunk a ray is in
+    struct RayChunk
+    {
+        i32Vec3 position;
+        bool valid{ false };
+        BlockView::Chunk chunk;
+    };
+
+    RayHit castRay(const Ray & ray, RayChunk & chunk);
+    bool lookUpChunk(const i32Vec3 chunk_position, BlockView::Chunk & chunk); // false if the chunk is unknown. any thread
+    void queueEdit(EditOperation && operation);
+    void applyEdits(Block * const container);
+    std::shared_ptr<EditBatch> startEditBatch(Block * const container);
+    void applyEditBatch(EditBatch & batch, const i32Vec3 chunk_position, Block * const container);
+    void finishEditBatch(EditBatch & batch);
+    void loadOrGenerateChunk(const i32Vec3 chunk_position, Block * const container);
+    bool readBlocks(Block * const destination, const i32Vec3 from_block, const i32Vec3 to_block, Block * const container); // false if a region is not loaded
+    void remesh(const i32Vec3 mesh_position);
+    bool reserveCommand(); // waits for a free slot, call it without holding other locks. false on exit
+    bool tryReserveCommand();
+    void releaseCommand(); // returns an unused reservation
+    void pushCommand(const Command::Type type, const i32Vec3 mesh_position, const std::vector<Vertex> & mesh); // uses a reserved slot
+    static const char * chunkData(const Region & region, const i32Vec3 chunk_position);
+#ifdef NEW_REGION_FORMAT
+    static bool beginChunkRead(Region & region, const i32Vec3 chunk_position, ChunkMeta & chunk_meta, const char * & source, int & epoch); // false if the region is not ready
+    static void endChunkRead(Region & region, const int epoch);
+    static void rereadChunk(Region & region, const i32Vec3 chunk_position, ChunkMeta & chunk_meta, const char * & source); // between beginChunkRead() and endChunkRead()
+#endif
+    static void decodeChunk(const ChunkMeta & chunk_meta, const char * const source, Block * const chunk);
+    static ChunkSummary summarizeStoredChunk(const Codec codec, const char * const data, const int size);
+    static void upgradeRegion(const std::string & file_name);
+    bool meshProvenEmpty(const i32Vec3 mesh_position) const;
     void saveMeshToMeshCache(const i32Vec3 mesh_position, const std::vector<Vertex> & mesh);
     bool removeOutOfRangeMeshes(const i32Vec3 center_mesh); // returns false if buffer is full and operation was not completed
     void meshLoader();
     void multiThreadMeshLoader(const int thread_id);
 
     void sineChunk(const i32Vec3 from_block, const i32Vec3 to_block);
-    void simplex2DChunkNew(Block * destination, const i32Vec3 from_block, const i32Vec3 to_block);
     void emptyChunk(const i32Vec3 from_block, const i32Vec3 to_block);
-    void sineChunkNew(Block * destination, const i32Vec3 from_block, const i32Vec3 to_block);
-    void emptyChunkNew(Block * destination, const i32Vec3 from_block, const i32Vec3 to_block);
     void smallBlockChunk(const i32Vec3 from_block, const i32Vec3 to_block);
     void floorTilesChunk(const i32Vec3 from_block, const i32Vec3 to_block);
 
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <iostream>
+
+// Checks for the test executables. Unlike assert they also run in release builds.
+// A failed check is reported and counted, main() returns checkResult() so ctest sees it.
+
+static int g_failed_checks{ 0 };
+
+#define CHECK(condition)                                                                            \
+    do                                                                                              \
+    {                                                                                               \
+        if (!(condition))                                                                           \
+        {                                                                                           \
+            ++g_failed_checks;                                                                      \
+            std::cerr << __FILE__ << ':' << __LINE__ << ": check failed: " #condition << std::endl; \
+        }                                                                                           \
+    } while (false)
+
+//==============================================================================
+inline int checkResult()
+{
+    if (g_failed_checks != 0)
+    {
+        std::cerr << g_failed_checks << " checks failed." << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
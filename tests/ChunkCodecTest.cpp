@@ -0,0 +1,124 @@
+#include "Check.hpp"
+#include "ChunkCodec.hpp"
+#include "PositionRandom.hpp"
+#include "Terrain.hpp"
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Round trips every available codec on synthetic and generated chunks, and checks the
+// palette representation of uniform chunks.
+
+static constexpr i32Vec3 CHUNK_SIZES{ 16, 16, 16 };
+static constexpr int CHUNK_SIZE{ 16 * 16 * 16 };
+static constexpr uint32_t SEED{ 0 };
+
+//==============================================================================
+static std::vector<char> chunkOf(const std::function<char(const i32Vec3 position)> & value)
+{
+    std::vector<char> chunk(CHUNK_SIZE);
+    i32Vec3 position;
+
+    for (position[2] = 0; position[2] < CHUNK_SIZES[2]; ++position[2])
+        for (position[1] = 0; position[1] < CHUNK_SIZES[1]; ++position[1])
+            for (position[0] = 0; position[0] < CHUNK_SIZES[0]; ++position[0])
+                chunk[position_to_index(position, CHUNK_SIZES)] = value(position);
+
+    return chunk;
+}
+
+//==============================================================================
+static std::vector<char> generated(const WorldType world_type, const i32Vec3 chunk_position)
+{
+    std::vector<Block> blocks(CHUNK_SIZE);
+    const auto from = chunk_position * CHUNK_SIZES;
+    Terrain::generate(blocks.data(), from, from + CHUNK_SIZES, world_type, SEED);
+
+    std::vector<char> chunk(CHUNK_SIZE);
+    std::memcpy(chunk.data(), blocks.data(), CHUNK_SIZE);
+
+    return chunk;
+}
+
+//==============================================================================
+static void roundTrip(const Codec codec, const std::string & label, const std::vector<char> & chunk)
+{
+    const auto capacity = ChunkCodec::bound(codec, CHUNK_SIZE);
+    std::vector<char> compressed(capacity);
+    std::vector<char> decompressed(CHUNK_SIZE, 0x55);
+
+    const auto size = ChunkCodec::compress(codec, compressed.data(), capacity, chunk.data(), CHUNK_SIZE, CHUNK_SIZES);
+
+    if (size == 0 || size > capacity)
+    {
+        CHECK(size > 0 && size <= capacity);
+        std::cerr << "  " << ChunkCodec::name(codec) << " failed to compress " << label << std::endl;
+        return;
+    }
+
+    const auto ok = ChunkCodec::decompress(codec, decompressed.data(), CHUNK_SIZE, compressed.data(), size, CHUNK_SIZES);
+
+    if (!ok || decompressed != chunk)
+    {
+        CHECK(ok && decompressed == chunk);
+        std::cerr << "  " << ChunkCodec::name(codec) << " changed " << label << std::endl;
+    }
+
+    // a destination that is too small must fail instead of overflowing
+    if (size > 1)
+        CHECK(ChunkCodec::compress(codec, compressed.data(), size - 1, chunk.data(), CHUNK_SIZE, CHUNK_SIZES) == 0);
+
+    // only a uniform palette chunk reports its value without decoding
+    char value = 0;
+    const bool is_uniform = std::all_of(chunk.begin(), chunk.end(), [&](const char c) { return c == chunk[0]; });
+    const bool reported = ChunkCodec::uniform(codec, compressed.data(), size, value);
+
+    CHECK(reported == (codec == Codec::PALETTE && is_uniform));
+    if (reported)
+    {
+        CHECK(value == chunk[0]);
+        CHECK(size == 1);
+    }
+}
+
+//==============================================================================
+int main()
+{
+    std::vector<std::pair<std::string, std::vector<char>>> chunks;
+
+    chunks.emplace_back("air", chunkOf([](const i32Vec3) { return char{ 0 }; }));
+    chunks.emplace_back("stone", chunkOf([](const i32Vec3) { return char{ 3 }; }));
+    chunks.emplace_back("negative", chunkOf([](const i32Vec3) { return char{ -1 }; }));
+    chunks.emplace_back("layers", chunkOf([](const i32Vec3 p) { return static_cast<char>(p[1] < 7 ? 1 : p[1] < 9 ? 2 : 0); }));
+    chunks.emplace_back("checker", chunkOf([](const i32Vec3 p) { return static_cast<char>((p[0] + p[1] + p[2]) % 2); }));
+
+    // 1, 2, 4 and 8 bit palette indices, and the largest palette
+    for (const int types : { 3, 4, 5, 16, 17, 256 })
+        chunks.emplace_back("random " + std::to_string(types), chunkOf([=](const i32Vec3 p) { return static_cast<char>(PositionRandom::of(SEED, p) % types); }));
+
+    for (const auto world_type : { WorldType::SINE, WorldType::FRACTAL_2D })
+        for (int y = -2; y <= 1; ++y)
+            chunks.emplace_back("terrain y " + std::to_string(y), generated(world_type, { 3, y, -5 }));
+
+    int codecs = 0;
+
+    for (int i = 0; i < static_cast<int>(Codec::last); ++i)
+    {
+        const auto codec = static_cast<Codec>(i);
+
+        if (!ChunkCodec::available(codec))
+            continue;
+
+        ++codecs;
+
+        for (const auto & chunk : chunks)
+            roundTrip(codec, chunk.first, chunk.second);
+    }
+
+    // always built in
+    CHECK(codecs >= 4);
+
+    return checkResult();
+}
@@ -0,0 +1,102 @@
+#include "Check.hpp"
+#include "ColumnCache.hpp"
+#include "PositionRandom.hpp"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+// Many threads hammer a small ColumnCache (constant eviction) and compare every result with
+// uncached Terrain::columns(). Build with -fsanitize=thread to also check the locking.
+
+static constexpr i32Vec3 CHUNK_SIZES{ 16, 16, 16 };
+static constexpr int COLUMN_COUNT{ 16 * 16 };
+static constexpr WorldType WORLD_TYPE{ WorldType::FRACTAL_2D };
+static constexpr uint32_t SEED{ 7 };
+static constexpr int THREAD_COUNT{ 8 };
+static constexpr int GETS_PER_THREAD{ 2000 };
+static constexpr int AREA{ 12 }; // columns per side, more than the small cache holds
+
+//==============================================================================
+static void compute(Terrain::Columns & destination, const i32Vec2 column_position)
+{
+    const i32Vec3 from{ column_position[0] * CHUNK_SIZES[0], 0, column_position[1] * CHUNK_SIZES[2] };
+    Terrain::columns(destination, from, from + CHUNK_SIZES, WORLD_TYPE, SEED);
+}
+
+//==============================================================================
+static bool same(const Terrain::Columns & a, const Terrain::Columns & b)
+{
+    for (int i = 0; i < COLUMN_COUNT; ++i)
+        if (a.heights[i] != b.heights[i])
+            return false;
+
+    return a.lowest == b.lowest && a.highest == b.highest;
+}
+
+//==============================================================================
+static i32Vec2 positionOf(const int index)
+{
+    return { index % AREA - AREA / 2, index / AREA - AREA / 2 };
+}
+
+//==============================================================================
+int main()
+{
+    std::vector<Terrain::Columns> expected(AREA * AREA);
+    for (int i = 0; i < AREA * AREA; ++i)
+        compute(expected[i], positionOf(i));
+
+    // concurrent gets with evictions
+    {
+        ColumnCache cache{ 32 };
+        std::atomic_int mismatches{ 0 };
+        std::vector<std::thread> threads;
+
+        for (int t = 0; t < THREAD_COUNT; ++t)
+            threads.emplace_back([&, t]
+            {
+                Terrain::Columns columns;
+
+                for (int i = 0; i < GETS_PER_THREAD; ++i)
+                {
+                    // mostly a few hot columns, so entries are hit, moved and evicted at the same time
+                    const auto random = PositionRandom::of(SEED, t, i, 0);
+                    const auto index = static_cast<int>(random >> 28 < 12 ? random % 8 : random % (AREA * AREA));
+                    const auto position = positionOf(index);
+
+                    cache.get(position, columns, [=](Terrain::Columns & destination) { compute(destination, position); });
+
+                    if (!same(columns, expected[index]))
+                        ++mismatches;
+                }
+            });
+
+        for (auto & thread : threads)
+            thread.join();
+
+        CHECK(mismatches == 0);
+        CHECK(cache.hits() + cache.misses() == THREAD_COUNT * GETS_PER_THREAD);
+        CHECK(cache.hits() > 0);
+    }
+
+    // everything fits: the second pass never computes
+    {
+        ColumnCache cache{ 4 * AREA * AREA };
+        Terrain::Columns columns;
+
+        for (int pass = 0; pass < 2; ++pass)
+            for (int i = 0; i < AREA * AREA; ++i)
+            {
+                bool computed = false;
+                cache.get(positionOf(i), columns, [&](Terrain::Columns & destination) { computed = true; compute(destination, positionOf(i)); });
+
+                CHECK(computed == (pass == 0));
+                CHECK(same(columns, expected[i]));
+            }
+
+        CHECK(cache.misses() == AREA * AREA);
+        CHECK(cache.hits() == AREA * AREA);
+    }
+
+    return checkResult();
+}
@@ -0,0 +1,107 @@
+#include "Check.hpp"
+#include "ConcurrentMemoryBlock.hpp"
+#include "PositionRandom.hpp"
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+// Many threads allocate from one small-unit ConcurrentMemoryBlock at once (units fill up all
+// the time) and fill their allocations. Afterwards nothing overlaps and the statistics add up.
+// Build with -fsanitize=thread to also check the atomics.
+
+static constexpr std::size_t UNIT_SIZE{ 4096 };
+static constexpr uint32_t SEED{ 11 };
+static constexpr int THREAD_COUNT{ 8 };
+static constexpr int ALLOCATIONS_PER_THREAD{ 5000 };
+
+using Block = ConcurrentMemoryBlock<UNIT_SIZE>;
+
+struct Allocation { char * data; std::size_t size; };
+
+//==============================================================================
+static std::size_t sizeOf(const int thread, const int i)
+{
+    return 1 + PositionRandom::of(SEED, thread, i, 0) % 600;
+}
+
+//==============================================================================
+static char valueOf(const int thread, const int i)
+{
+    return static_cast<char>(thread * 31 + i);
+}
+
+//==============================================================================
+static bool filled(const Allocation & allocation, const char value)
+{
+    for (std::size_t i = 0; i < allocation.size; ++i)
+        if (allocation.data[i] != value)
+            return false;
+
+    return true;
+}
+
+//==============================================================================
+// returns the number of bytes allocated
+static std::size_t allocateConcurrently(Block & block, std::vector<std::vector<Allocation>> & allocations)
+{
+    std::vector<std::thread> threads;
+    allocations.assign(THREAD_COUNT, {});
+
+    for (int t = 0; t < THREAD_COUNT; ++t)
+        threads.emplace_back([&, t]
+        {
+            for (int i = 0; i < ALLOCATIONS_PER_THREAD; ++i)
+            {
+                const auto size = sizeOf(t, i);
+                auto * const data = block.allocate(size);
+                std::memset(data, valueOf(t, i), size);
+                allocations[t].push_back({ data, size });
+            }
+        });
+
+    for (auto & thread : threads)
+        thread.join();
+
+    std::size_t bytes = 0;
+
+    for (int t = 0; t < THREAD_COUNT; ++t)
+        for (int i = 0; i < ALLOCATIONS_PER_THREAD; ++i)
+        {
+            // another thread writing into the same bytes would have changed them
+            CHECK(filled(allocations[t][i], valueOf(t, i)));
+            bytes += allocations[t][i].size;
+        }
+
+    return bytes;
+}
+
+//==============================================================================
+int main()
+{
+    Block block;
+    std::vector<std::vector<Allocation>> allocations;
+
+    const auto bytes = allocateConcurrently(block, allocations);
+    CHECK(block.bytesUsed() == bytes);
+    CHECK(block.bytesUsed() + block.bytesWasted() <= block.bytesReserved());
+    CHECK(block.bytesReserved() % UNIT_SIZE == 0);
+
+    // moving keeps the data in place
+    Block moved{ std::move(block) };
+    CHECK(block.bytesReserved() == 0 && block.bytesUsed() == 0);
+    CHECK(moved.bytesUsed() == bytes);
+    CHECK(filled(allocations[THREAD_COUNT - 1][0], valueOf(THREAD_COUNT - 1, 0)));
+
+    // a reset keeps the units, they are filled again
+    const auto reserved = moved.bytesReserved();
+    moved.reset();
+    CHECK(moved.bytesUsed() == 0 && moved.bytesWasted() == 0);
+    CHECK(moved.bytesReserved() == reserved);
+
+    CHECK(allocateConcurrently(moved, allocations) == bytes);
+    CHECK(moved.bytesUsed() == bytes);
+    CHECK(moved.bytesUsed() + moved.bytesWasted() <= moved.bytesReserved());
+
+    return checkResult();
+}
@@ -0,0 +1,214 @@
+#include "Check.hpp"
+#include "PositionRandom.hpp"
+#include "Raycast.hpp"
+#include <cmath>
+#include <limits>
+#include <vector>
+
+// Voxel traversal against dense sampling along random rays, in a box of chunks with sparse
+// random blocks, where some chunks are empty. Outside the box chunks are unknown.
+// Samples close to a block face are skipped, rays that only graze an edge may go either way.
+
+static constexpr i32Vec3 CHUNK_SIZES{ 16, 16, 16 };
+static constexpr int CHUNK_SIZE{ 16 * 16 * 16 };
+static constexpr i32Vec3 FROM_CHUNK{ -2, -2, -2 };
+static constexpr i32Vec3 TO_CHUNK{ 2, 2, 2 };
+static constexpr uint32_t SEED{ 3 };
+static constexpr int RAY_COUNT{ 5000 };
+static constexpr float MAX_DISTANCE{ 60.0f };
+static constexpr float SAMPLE_STEP{ 0.01f };
+static constexpr float EPSILON{ 0.002f };
+
+//==============================================================================
+class Grid
+{
+public:
+    Grid()
+    {
+        const auto counts = TO_CHUNK - FROM_CHUNK;
+        m_chunks.resize(static_cast<std::size_t>(counts[0] * counts[1] * counts[2]));
+
+        i32Vec3 chunk;
+        for (chunk[2] = FROM_CHUNK[2]; chunk[2] < TO_CHUNK[2]; ++chunk[2])
+            for (chunk[1] = FROM_CHUNK[1]; chunk[1] < TO_CHUNK[1]; ++chunk[1])
+                for (chunk[0] = FROM_CHUNK[0]; chunk[0] < TO_CHUNK[0]; ++chunk[0])
+                {
+                    // a third of the chunks is empty, the others have 1 to 4 percent solid blocks
+                    const auto random = PositionRandom::of(SEED, chunk);
+                    auto & blocks = m_chunks[indexOf(chunk)];
+                    blocks.resize(CHUNK_SIZE);
+
+                    if (random % 3 == 0)
+                        continue;
+
+                    const auto percent = 1 + static_cast<int>(random / 3 % 4);
+
+                    i32Vec3 position;
+                    for (position[2] = 0; position[2] < CHUNK_SIZES[2]; ++position[2])
+                        for (position[1] = 0; position[1] < CHUNK_SIZES[1]; ++position[1])
+                            for (position[0] = 0; position[0] < CHUNK_SIZES[0]; ++position[0])
+                            {
+                                const auto block = chunk * CHUNK_SIZES + position;
+
+                                if (static_cast<int>(PositionRandom::of(SEED + 1, block) % 100) < percent)
+                                    blocks[position_to_index(block, CHUNK_SIZES)] = Block{ static_cast<signed char>(1 + PositionRandom::of(SEED + 2, block) % 3) };
+                            }
+
+                    m_solid_chunk_count += 1;
+                }
+    }
+
+    static bool known(const i32Vec3 chunk) { return all(chunk >= FROM_CHUNK) && all(chunk < TO_CHUNK); }
+
+    bool empty(const i32Vec3 chunk) const
+    {
+        for (const auto block : m_chunks[indexOf(chunk)])
+            if (!block.isEmpty())
+                return false;
+
+        return true;
+    }
+
+    const Block * blocks(const i32Vec3 chunk) const { return m_chunks[indexOf(chunk)].data(); }
+
+    // 0 for air, -1 if unknown
+    int at(const i32Vec3 block) const
+    {
+        const auto chunk = floor_div(block, CHUNK_SIZES);
+        return known(chunk) ? blocks(chunk)[position_to_index(block, CHUNK_SIZES)].get() : -1;
+    }
+
+    int solidChunkCount() const { return m_solid_chunk_count; }
+
+private:
+    std::vector<std::vector<Block>> m_chunks;
+    int m_solid_chunk_count{ 0 };
+
+    static int indexOf(const i32Vec3 chunk) { return to_index(chunk - FROM_CHUNK, TO_CHUNK - FROM_CHUNK); }
+
+};
+
+//==============================================================================
+static float unit(const int ray, const int k)
+{
+    return static_cast<float>(PositionRandom::of(SEED, ray, k, 7) >> 8) / static_cast<float>(1 << 24);
+}
+
+//==============================================================================
+// distance of the first solid block found by sampling, or infinity if the ray reaches the distance or unknown chunks first
+static float sample(const Grid & grid, const Raycast::Ray & ray, const f32Vec3 direction, const float distance)
+{
+    for (float s = 0.0f; s <= distance; s += SAMPLE_STEP)
+    {
+        const auto point = ray.origin + direction * s;
+        bool near_face = false;
+        i32Vec3 block;
+
+        for (int i = 0; i < 3; ++i)
+        {
+            const auto floor = std::floor(point[i]);
+            near_face |= point[i] - floor < EPSILON || floor + 1.0f - point[i] < EPSILON;
+            block[i] = ray.base[i] + static_cast<int>(floor);
+        }
+
+        const auto type = grid.at(block);
+
+        if (type == -1)
+            break;
+
+        if (type != 0 && !near_face)
+            return s;
+    }
+
+    return std::numeric_limits<float>::infinity();
+}
+
+//==============================================================================
+int main()
+{
+    const Grid grid;
+
+    // empty chunks are crossed in one step, or block by block when they are passed as blocks
+    const auto skipping = [&](const i32Vec3 chunk, const Block * & blocks)
+    {
+        blocks = Grid::known(chunk) && !grid.empty(chunk) ? grid.blocks(chunk) : nullptr;
+        return Grid::known(chunk);
+    };
+    const auto walking = [&](const i32Vec3 chunk, const Block * & blocks)
+    {
+        blocks = Grid::known(chunk) ? grid.blocks(chunk) : nullptr;
+        return Grid::known(chunk);
+    };
+
+    int hits = 0;
+
+    for (int r = 0; r < RAY_COUNT; ++r)
+    {
+        Raycast::Ray ray;
+
+        for (int i = 0; i < 3; ++i)
+        {
+            const auto position = (FROM_CHUNK[i] + (TO_CHUNK[i] - FROM_CHUNK[i]) * unit(r, i)) * CHUNK_SIZES[i];
+            ray.base[i] = static_cast<int>(std::floor(position)) - 3;
+            ray.origin[i] = position - static_cast<float>(ray.base[i]);
+            ray.direction[i] = unit(r, 3 + i) * 2.0f - 1.0f;
+        }
+
+        // axis aligned rays have infinite steps on the other axes
+        if (r % 10 == 0) ray.direction[r / 10 % 3] = 0.0f;
+        if (r % 20 == 0) ray.direction[(r / 10 + 1) % 3] = 0.0f;
+        if (dot(ray.direction, ray.direction) < 0.01f) continue;
+
+        ray.max_distance = MAX_DISTANCE * unit(r, 6);
+
+        const auto direction = ray.direction / std::sqrt(dot(ray.direction, ray.direction));
+        const auto hit = Raycast::cast(ray, CHUNK_SIZES, skipping);
+        const auto walked = Raycast::cast(ray, CHUNK_SIZES, walking);
+
+        CHECK(hit.hit == walked.hit);
+        if (hit.hit && walked.hit)
+        {
+            CHECK(all(hit.block == walked.block));
+            CHECK(all(hit.normal == walked.normal));
+            CHECK(std::abs(hit.distance - walked.distance) < EPSILON);
+        }
+
+        const auto sampled = sample(grid, ray, direction, ray.max_distance);
+
+        if (!hit.hit)
+        {
+            // nothing solid along the ray
+            CHECK(sampled == std::numeric_limits<float>::infinity());
+            continue;
+        }
+
+        ++hits;
+
+        CHECK(grid.at(hit.block) > 0 && hit.type.get() == grid.at(hit.block));
+        CHECK(hit.distance <= ray.max_distance);
+
+        // sampling finds nothing solid before the hit
+        CHECK(sample(grid, ray, direction, hit.distance - EPSILON) == std::numeric_limits<float>::infinity());
+
+        // the ray enters the block at the hit distance, through the face of the normal
+        const auto point = ray.origin + direction * hit.distance;
+        for (int i = 0; i < 3; ++i)
+        {
+            const auto from = static_cast<float>(hit.block[i] - ray.base[i]);
+            CHECK(point[i] >= from - EPSILON && point[i] <= from + 1.0f + EPSILON);
+
+            if (hit.normal[i] != 0)
+                CHECK(std::abs(point[i] - (hit.normal[i] > 0 ? from + 1.0f : from)) < EPSILON && hit.normal[i] == (direction[i] > 0.0f ? -1 : 1));
+        }
+
+        const auto normal_axes = std::abs(hit.normal[0]) + std::abs(hit.normal[1]) + std::abs(hit.normal[2]);
+        CHECK(normal_axes == (hit.distance == 0.0f ? 0 : 1));
+    }
+
+    // the scene is not degenerate
+    CHECK(grid.solidChunkCount() > 0);
+    CHECK(hits > RAY_COUNT / 10);
+    CHECK(hits < RAY_COUNT);
+
+    return checkResult();
+}
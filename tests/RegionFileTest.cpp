@@ -0,0 +1,248 @@
+#include "Check.hpp"
+#include "RegionFile.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+// Region file writes, staged commits, retired sectors, crash consistency (a file closed
+// without committing) and compaction. Files are created in a temporary directory.
+
+static constexpr int CHUNK_COUNT{ 64 };
+static constexpr std::size_t USER_HEADER_SIZE{ 100 };
+
+//==============================================================================
+static std::vector<char> chunkData(const int index, const int version, const int size)
+{
+    std::vector<char> data(static_cast<std::size_t>(size));
+
+    for (int i = 0; i < size; ++i)
+        data[static_cast<std::size_t>(i)] = static_cast<char>(i * 7 + index * 13 + version * 31);
+
+    return data;
+}
+
+//==============================================================================
+static bool holds(const RegionFile & file, const int index, const std::vector<char> & data)
+{
+    return file.chunkSize(index) == static_cast<int>(data.size()) && std::memcmp(file.chunk(index), data.data(), data.size()) == 0;
+}
+
+//==============================================================================
+static void writeAndReopen(const std::string & file_name)
+{
+    RegionFile file;
+    file.create(file_name, CHUNK_COUNT, USER_HEADER_SIZE);
+
+    for (int i = 0; i < CHUNK_COUNT; ++i)
+        CHECK(file.chunkSize(i) == 0);
+
+    const auto small = chunkData(1, 0, 100);
+    const auto large = chunkData(2, 0, 1000);
+    const char header[] = "user header";
+
+    file.writeChunk(1, small.data(), static_cast<int>(small.size()), 5);
+    file.writeChunk(2, large.data(), static_cast<int>(large.size()));
+    file.writeUserHeader(header, 10, sizeof(header));
+    CHECK(holds(file, 1, small) && file.chunkTag(1) == 5);
+    CHECK(holds(file, 2, large) && file.chunkTag(2) == 0);
+
+    // shrinking in place and growing into new sectors
+    const auto shrunk = chunkData(2, 1, 300);
+    const auto grown = chunkData(1, 1, 700);
+    file.writeChunk(2, shrunk.data(), static_cast<int>(shrunk.size()));
+    file.writeChunk(1, grown.data(), static_cast<int>(grown.size()), 6);
+    CHECK(file.usedSectors() == 2 + 3);
+
+    file.eraseChunk(2);
+    CHECK(file.chunkSize(2) == 0);
+    file.writeChunk(2, shrunk.data(), static_cast<int>(shrunk.size()));
+
+    file.sync();
+    file.close();
+
+    std::size_t user_header_size = 0;
+    CHECK(RegionFile::detect(file_name, &user_header_size) == RegionFile::Format::SECTORS);
+    CHECK(user_header_size == USER_HEADER_SIZE);
+    CHECK(RegionFile::detect(file_name + ".missing") == RegionFile::Format::MISSING);
+
+    CHECK(file.open(file_name, CHUNK_COUNT, USER_HEADER_SIZE));
+    CHECK(holds(file, 1, grown) && file.chunkTag(1) == 6);
+    CHECK(holds(file, 2, shrunk));
+    CHECK(file.usedSectors() == 3 + 2);
+
+    char read_header[sizeof(header)];
+    file.readUserHeader(read_header, 10, sizeof(header));
+    CHECK(std::memcmp(read_header, header, sizeof(header)) == 0);
+}
+
+//==============================================================================
+static void stageAndCommit(const std::string & file_name)
+{
+    RegionFile file;
+    file.create(file_name, CHUNK_COUNT, USER_HEADER_SIZE);
+
+    const auto old_data = chunkData(3, 0, 500);
+    file.writeChunk(3, old_data.data(), static_cast<int>(old_data.size()));
+    const auto used = file.usedSectors();
+
+    // staged chunks are invisible until committed, the old data stays readable
+    const auto new_data = chunkData(3, 1, 500);
+    const auto added = chunkData(4, 1, 200);
+    file.stageChunk(3, new_data.data(), static_cast<int>(new_data.size()), 7);
+    file.stageChunk(4, added.data(), static_cast<int>(added.size()));
+    CHECK(holds(file, 3, old_data));
+    CHECK(file.chunkSize(4) == 0);
+
+    // staging an index again replaces the staged copy
+    const auto newer_data = chunkData(3, 2, 600);
+    file.stageChunk(3, newer_data.data(), static_cast<int>(newer_data.size()), 7);
+    CHECK(file.usedSectors() == used + 3 + 1);
+
+    file.commit();
+    CHECK(holds(file, 3, newer_data) && file.chunkTag(3) == 7);
+    CHECK(holds(file, 4, added));
+    CHECK(file.usedSectors() == 3 + 1);
+
+    // discarded chunks never show up and give their sectors back
+    file.stageChunk(5, added.data(), static_cast<int>(added.size()));
+    file.discardStaged();
+    CHECK(file.chunkSize(5) == 0);
+    CHECK(file.usedSectors() == 3 + 1);
+    file.commit();
+    CHECK(file.chunkSize(5) == 0);
+}
+
+//==============================================================================
+static void retiredSectors(const std::string & file_name)
+{
+    RegionFile file;
+    file.create(file_name, CHUNK_COUNT, USER_HEADER_SIZE);
+
+    const auto old_data = chunkData(6, 0, 400);
+    file.writeChunk(6, old_data.data(), static_cast<int>(old_data.size()));
+    const auto * old_chunk = file.chunk(6);
+
+    const auto new_data = chunkData(6, 1, 400);
+    file.stageChunk(6, new_data.data(), static_cast<int>(new_data.size()));
+    file.sync();
+    file.publish();
+    CHECK(holds(file, 6, new_data));
+
+    // a reader that looked the chunk up before publish() still sees the old data,
+    // its sectors are not handed out again before releaseRetired()
+    for (int i = 0; i < 8; ++i)
+    {
+        const auto other = chunkData(10 + i, 0, 400);
+        file.stageChunk(10 + i, other.data(), static_cast<int>(other.size()));
+    }
+    CHECK(std::memcmp(old_chunk, old_data.data(), old_data.size()) == 0);
+
+    file.discardStaged();
+    file.sync();
+    file.releaseRetired();
+    CHECK(file.usedSectors() == 2);
+    CHECK(holds(file, 6, new_data));
+}
+
+//==============================================================================
+static void crashBeforeCommit(const std::string & file_name)
+{
+    const auto old_data = chunkData(7, 0, 300);
+    const auto new_data = chunkData(7, 1, 300);
+    const auto added = chunkData(8, 1, 300);
+
+    {
+        RegionFile file;
+        file.create(file_name, CHUNK_COUNT, USER_HEADER_SIZE);
+        file.writeChunk(7, old_data.data(), static_cast<int>(old_data.size()));
+        file.sync();
+
+        // staged data reaches the file, but the table never points to it
+        file.stageChunk(7, new_data.data(), static_cast<int>(new_data.size()));
+        file.stageChunk(8, added.data(), static_cast<int>(added.size()));
+        file.sync();
+    }
+
+    RegionFile file;
+    CHECK(file.open(file_name, CHUNK_COUNT, USER_HEADER_SIZE));
+    CHECK(holds(file, 7, old_data));
+    CHECK(file.chunkSize(8) == 0);
+
+    // the sectors of the lost chunks are free again
+    CHECK(file.usedSectors() == 2);
+}
+
+//==============================================================================
+static void compaction(const std::string & file_name)
+{
+    static constexpr int SIZE{ 32 * 1024 };
+
+    RegionFile file;
+    file.create(file_name, CHUNK_COUNT, USER_HEADER_SIZE);
+
+    for (int i = 0; i < CHUNK_COUNT; ++i)
+    {
+        const auto data = chunkData(i, 0, SIZE - i);
+        file.writeChunk(i, data.data(), static_cast<int>(data.size()), i);
+    }
+
+    CHECK(!file.needsCompaction());
+
+    for (int i = 0; i < CHUNK_COUNT; ++i)
+        if (i % 4 != 0)
+            file.eraseChunk(i);
+
+    CHECK(file.needsCompaction());
+
+    const auto total = file.totalSectors();
+    file.compact();
+    CHECK(file.isOpen());
+    CHECK(file.totalSectors() < total);
+    CHECK(file.totalSectors() == file.usedSectors());
+    CHECK(!file.needsCompaction());
+
+    for (int i = 0; i < CHUNK_COUNT; ++i)
+    {
+        if (i % 4 == 0)
+            CHECK(holds(file, i, chunkData(i, 0, SIZE - i)) && file.chunkTag(i) == i);
+        else
+            CHECK(file.chunkSize(i) == 0);
+    }
+
+    file.close();
+
+    // the static form reopens the file, it must stay intact
+    RegionFile::compact(file_name, CHUNK_COUNT, USER_HEADER_SIZE);
+    CHECK(file.open(file_name, CHUNK_COUNT, USER_HEADER_SIZE));
+    for (int i = 0; i < CHUNK_COUNT; i += 4)
+        CHECK(holds(file, i, chunkData(i, 0, SIZE - i)));
+    CHECK(::access((file_name + ".tmp").c_str(), F_OK) != 0);
+}
+
+//==============================================================================
+int main()
+{
+    char directory[] = "region_file_test.XXXXXX";
+
+    if (::mkdtemp(directory) == nullptr)
+    {
+        std::cerr << "Creating a temporary directory failed." << std::endl;
+        return 1;
+    }
+
+    const std::string prefix = std::string{ directory } + "/";
+
+    writeAndReopen(prefix + "write.rg");
+    stageAndCommit(prefix + "stage.rg");
+    retiredSectors(prefix + "retired.rg");
+    crashBeforeCommit(prefix + "crash.rg");
+    compaction(prefix + "compact.rg");
+
+    for (const auto * name : { "write.rg", "stage.rg", "retired.rg", "crash.rg", "compact.rg" })
+        ::unlink((prefix + name).c_str());
+    ::rmdir(directory);
+
+    return checkResult();
+}
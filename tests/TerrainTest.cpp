@@ -0,0 +1,120 @@
+#include "Check.hpp"
+#include "PositionRandom.hpp"
+#include "Terrain.hpp"
+#include <cmath>
+#include <vector>
+
+// SINE against the per block generator it replaced, so existing worlds generate the same.
+// For every height based world type: chunks generated in parts match whole chunks, passing
+// precomputed columns changes nothing, and ranges reported uniform really are.
+
+static constexpr i32Vec3 CHUNK_SIZES{ 16, 16, 16 };
+static constexpr int CHUNK_SIZE{ 16 * 16 * 16 };
+static constexpr i32Vec3 FROM_CHUNK{ -3, -2, -3 };
+static constexpr i32Vec3 TO_CHUNK{ 3, 2, 3 };
+
+//==============================================================================
+// the generator before columns were introduced, kept verbatim as the reference
+static void sinePerBlock(Block * destination, const i32Vec3 from_block, const i32Vec3 to_block, const uint32_t seed)
+{
+    const auto ground = [](const uint32_t random)
+    {
+        const auto value = random >> 28;
+        return Block{ static_cast<signed char>(value < 3 ? 3 : value < 11 ? 2 : 1) };
+    };
+
+    i32Vec3 position;
+    int i = 0;
+
+    for (position[2] = from_block[2]; position[2] < to_block[2]; ++position[2])
+        for (position[1] = from_block[1]; position[1] < to_block[1]; ++position[1])
+            for (position[0] = from_block[0]; position[0] < to_block[0]; ++position[0])
+            {
+                auto & block = destination[i++];
+
+                if (std::sin(position[0] * 0.1f) * std::sin(position[2] * 0.1f) * 10.0f > static_cast<float>(position[1]))
+                    block = ground(PositionRandom::of(seed, position));
+                else
+                    block = Block{ 0 };
+            }
+}
+
+//==============================================================================
+static bool same(const std::vector<Block> & a, const std::vector<Block> & b)
+{
+    for (std::size_t i = 0; i < a.size(); ++i)
+        if (a[i].get() != b[i].get())
+            return false;
+
+    return a.size() == b.size();
+}
+
+//==============================================================================
+static void checkChunk(const WorldType world_type, const uint32_t seed, const i32Vec3 chunk_position)
+{
+    const auto from = chunk_position * CHUNK_SIZES;
+    const auto to = from + CHUNK_SIZES;
+
+    std::vector<Block> whole(CHUNK_SIZE);
+    Terrain::generate(whole.data(), from, to, world_type, seed);
+
+    if (world_type == WorldType::SINE)
+    {
+        std::vector<Block> reference(CHUNK_SIZE);
+        sinePerBlock(reference.data(), from, to, seed);
+        CHECK(same(whole, reference));
+    }
+
+    // columns computed once for the chunk column
+    Terrain::Columns columns;
+    Terrain::columns(columns, from, to, world_type, seed);
+    std::vector<Block> with_columns(CHUNK_SIZE);
+    Terrain::generate(with_columns.data(), from, to, world_type, seed, columns);
+    CHECK(same(whole, with_columns));
+
+    // the same chunk in 8^3 parts
+    std::vector<Block> parts(CHUNK_SIZE);
+    std::vector<Block> part(8 * 8 * 8);
+    i32Vec3 offset;
+
+    for (offset[2] = 0; offset[2] < 16; offset[2] += 8)
+        for (offset[1] = 0; offset[1] < 16; offset[1] += 8)
+            for (offset[0] = 0; offset[0] < 16; offset[0] += 8)
+            {
+                Terrain::generate(part.data(), from + offset, from + offset + 8, world_type, seed);
+
+                i32Vec3 p;
+                for (p[2] = 0; p[2] < 8; ++p[2])
+                    for (p[1] = 0; p[1] < 8; ++p[1])
+                        for (p[0] = 0; p[0] < 8; ++p[0])
+                            parts[position_to_index(offset + p, CHUNK_SIZES)] = part[position_to_index(p, i32Vec3{ 8, 8, 8 })];
+            }
+
+    CHECK(same(whole, parts));
+
+    Block value;
+    if (Terrain::uniform(from, to, world_type, value))
+        for (const auto block : whole)
+            if (block.get() != value.get())
+            {
+                CHECK(block.get() == value.get());
+                break;
+            }
+}
+
+//==============================================================================
+int main()
+{
+    for (const auto world_type : { WorldType::SINE, WorldType::SIMPLEX_2D, WorldType::FRACTAL_2D, WorldType::STAGED })
+        for (const uint32_t seed : { 0u, 12345u })
+        {
+            i32Vec3 chunk;
+
+            for (chunk[2] = FROM_CHUNK[2]; chunk[2] < TO_CHUNK[2]; ++chunk[2])
+                for (chunk[1] = FROM_CHUNK[1]; chunk[1] < TO_CHUNK[1]; ++chunk[1])
+                    for (chunk[0] = FROM_CHUNK[0]; chunk[0] < TO_CHUNK[0]; ++chunk[0])
+                        checkChunk(world_type, seed, chunk);
+        }
+
+    return checkResult();
+}
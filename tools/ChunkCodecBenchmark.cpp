@@ -0,0 +1,123 @@
+#include "ChunkCodec.hpp"
+#include "Terrain.hpp"
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+// Compares chunk codecs on generated terrain: compression ratio and throughput
+// (MB/s of uncompressed data). Usage: chunk_codec_benchmark [repetitions]
+
+static constexpr i32Vec3 CHUNK_SIZES{ 16, 16, 16 };
+static constexpr int CHUNK_DATA_SIZE{ 16 * 16 * 16 * sizeof(Block) };
+static constexpr i32Vec3 FROM_CHUNK{ -8, -2, -8 }; // sky, surface and underground
+static constexpr i32Vec3 TO_CHUNK{ 8, 2, 8 };
+static constexpr std::size_t ZSTD_DICTIONARY_SIZE{ 16 * 1024 };
+static constexpr uint32_t SEED{ 0 };
+
+using Clock = std::chrono::steady_clock;
+
+//==============================================================================
+static double seconds(const Clock::duration duration)
+{
+    return std::chrono::duration<double>{ duration }.count();
+}
+
+//==============================================================================
+static void run(const Codec codec, const char * label, const std::vector<Block> & chunks, const int chunk_count, const int repetitions)
+{
+    const auto capacity = ChunkCodec::bound(codec, CHUNK_DATA_SIZE);
+    std::vector<char> compressed(capacity * chunk_count);
+    std::vector<std::size_t> sizes(chunk_count);
+    std::vector<Block> decompressed(chunks.size());
+
+    const auto * source = reinterpret_cast<const char *>(chunks.data());
+    auto * destination = reinterpret_cast<char *>(decompressed.data());
+
+    const auto compress_begin = Clock::now();
+    for (int r = 0; r < repetitions; ++r)
+        for (int i = 0; i < chunk_count; ++i)
+            sizes[i] = ChunkCodec::compress(codec, compressed.data() + capacity * i, capacity, source + CHUNK_DATA_SIZE * i, CHUNK_DATA_SIZE, CHUNK_SIZES);
+    const auto compress_time = seconds(Clock::now() - compress_begin);
+
+    bool ok = true;
+    const auto decompress_begin = Clock::now();
+    for (int r = 0; r < repetitions; ++r)
+        for (int i = 0; i < chunk_count; ++i)
+            ok &= ChunkCodec::decompress(codec, destination + CHUNK_DATA_SIZE * i, CHUNK_DATA_SIZE, compressed.data() + capacity * i, sizes[i], CHUNK_SIZES);
+    const auto decompress_time = seconds(Clock::now() - decompress_begin);
+
+    std::size_t total = 0;
+    for (const auto size : sizes) total += size;
+
+    ok &= std::memcmp(source, destination, chunks.size() * sizeof(Block)) == 0;
+
+    const double megabytes = static_cast<double>(CHUNK_DATA_SIZE) * chunk_count * repetitions / (1024.0 * 1024.0);
+
+    std::cout << std::left << std::setw(16) << label << std::right << std::fixed << std::setprecision(2)
+              << std::setw(10) << static_cast<double>(CHUNK_DATA_SIZE) * chunk_count / total
+              << std::setw(14) << static_cast<double>(total) / chunk_count
+              << std::setw(14) << megabytes / compress_time
+              << std::setw(14) << megabytes / decompress_time
+              << (ok ? "" : "  ROUND TRIP FAILED") << '\n';
+}
+
+//==============================================================================
+int main(int argc, char * argv[])
+{
+    const int repetitions = argc > 1 ? std::max(1, std::atoi(argv[1])) : 10;
+
+    const auto counts = TO_CHUNK - FROM_CHUNK;
+    const int chunk_count = product(counts);
+    std::vector<Block> chunks(static_cast<std::size_t>(chunk_count) * CHUNK_DATA_SIZE);
+
+    int i = 0;
+    i32Vec3 chunk;
+    for (chunk[2] = FROM_CHUNK[2]; chunk[2] < TO_CHUNK[2]; ++chunk[2])
+        for (chunk[1] = FROM_CHUNK[1]; chunk[1] < TO_CHUNK[1]; ++chunk[1])
+            for (chunk[0] = FROM_CHUNK[0]; chunk[0] < TO_CHUNK[0]; ++chunk[0])
+            {
+                const auto from = chunk * CHUNK_SIZES;
+                Terrain::generate(chunks.data() + CHUNK_DATA_SIZE * i++, from, from + CHUNK_SIZES, WorldType::SIMPLEX_2D, SEED);
+            }
+
+    std::cout << chunk_count << " chunks, " << repetitions << " repetitions\n"
+              << std::left << std::setw(16) << "codec" << std::right
+              << std::setw(10) << "ratio" << std::setw(14) << "avg bytes" << std::setw(14) << "comp MB/s" << std::setw(14) << "decomp MB/s" << '\n';
+
+    for (int c = 0; c < static_cast<int>(Codec::last); ++c)
+    {
+        const auto codec = static_cast<Codec>(c);
+
+        if (ChunkCodec::available(codec))
+            run(codec, ChunkCodec::name(codec), chunks, chunk_count, repetitions);
+    }
+
+    if (ChunkCodec::available(Codec::ZSTD))
+    {
+        // train on every other chunk, so the dictionary is not only tested on its own samples
+        std::vector<char> samples;
+        std::vector<std::size_t> sample_sizes;
+        for (int c = 0; c < chunk_count; c += 2)
+        {
+            const auto * begin = reinterpret_cast<const char *>(chunks.data() + CHUNK_DATA_SIZE * c);
+            samples.insert(samples.end(), begin, begin + CHUNK_DATA_SIZE);
+            sample_sizes.push_back(CHUNK_DATA_SIZE);
+        }
+
+        const auto dictionary = ChunkCodec::trainZstdDictionary(samples, sample_sizes, ZSTD_DICTIONARY_SIZE);
+
+        if (dictionary.empty())
+        {
+            std::cout << "zstd dictionary training failed\n";
+        }
+        else
+        {
+            ChunkCodec::setZstdDictionary(dictionary.data(), dictionary.size());
+            run(Codec::ZSTD, "zstd+dictionary", chunks, chunk_count, repetitions);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,312 @@
+#include "ChunkCodec.hpp"
+#include "ChunkSummary.hpp"
+#include "ColumnCache.hpp"
+#include "RegionFile.hpp"
+#include "Settings.hpp"
+#include "Terrain.hpp"
+#include "TerrainPipeline.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/stat.h>
+
+// Generates whole regions without the game and writes them in the format World reads,
+// so terrain does not have to be generated while playing.
+// Usage: region_pregen from_x from_y from_z to_x to_y to_z [threads] [--meshes] [--force]
+// Coordinates are region positions, both corners inclusive. Existing region files are
+// skipped unless --force is given. --meshes also stores which meshes are known to be empty.
+
+// same values as in World, region files written with different ones are rejected when loading
+static constexpr i32Vec3 CHUNK_SIZES{ 16, 16, 16 };
+static constexpr int CHUNK_SIZE{ 16 * 16 * 16 };
+static constexpr std::size_t CHUNK_DATA_SIZE{ CHUNK_SIZE * sizeof(Block) };
+static constexpr int REGION_SIZE{ 32 }; // chunks and meshes per axis
+static constexpr i32Vec3 REGION_SIZES{ REGION_SIZE, REGION_SIZE, REGION_SIZE };
+static constexpr int CHUNK_REGION_SIZE{ REGION_SIZE * REGION_SIZE * REGION_SIZE };
+static constexpr std::size_t REGION_SUMMARIES_OFFSET{ CHUNK_REGION_SIZE }; // one mesh status (char) per mesh
+static constexpr std::size_t REGION_USER_HEADER_SIZE{ REGION_SUMMARIES_OFFSET + sizeof(ChunkSummary) * CHUNK_REGION_SIZE };
+static constexpr char MESH_EMPTY{ 1 }; // World::Region::MStatus::EMPTY
+static constexpr int PALETTE_MAX_BITS{ 2 };
+static constexpr std::size_t PALETTE_MAX_SIZE{ 2 + (1 << PALETTE_MAX_BITS) + CHUNK_DATA_SIZE * PALETTE_MAX_BITS / 8 };
+static constexpr Codec CHUNK_CODEC{ WORLD_CHUNK_CODEC };
+static constexpr WorldType WORLD_TYPE{ WORLD_GENERATOR };
+static constexpr char WORLD_ROOT[]{ "world/" };
+static constexpr int COLUMN_CACHE_PER_THREAD{ 256 }; // a row of chunk columns is in use per region, with room to spare
+
+using Clock = std::chrono::steady_clock;
+
+namespace
+{
+    struct Progress
+    {
+        std::atomic<int> regions{ 0 };
+        std::atomic<int> skipped{ 0 };
+        std::atomic<long long> chunks{ 0 };
+        std::atomic<long long> bytes{ 0 };
+    };
+
+    struct Options
+    {
+        i32Vec3 from, to;
+        int threads;
+        bool meshes, force;
+    };
+}
+
+//==============================================================================
+static void generateChunk(Block * const destination, const i32Vec3 chunk_position, ColumnCache & column_cache)
+{
+    const auto from = chunk_position * CHUNK_SIZES;
+    const auto to = from + CHUNK_SIZES;
+
+    // same as the loader threads: uniform chunks (sky) are filled without running the generator
+    Block value;
+    if (Terrain::uniform(from, to, WORLD_TYPE, value))
+    {
+        std::fill(destination, destination + CHUNK_SIZE, value);
+        return;
+    }
+
+    if (!Terrain::hasColumns(WORLD_TYPE))
+    {
+        Terrain::generate(destination, from, to, WORLD_TYPE, WORLD_SEED);
+        return;
+    }
+
+    Terrain::Columns columns;
+    column_cache.get({ chunk_position[0], chunk_position[2] }, columns, [=](Terrain::Columns & destination)
+    {
+        Terrain::columns(destination, from, to, WORLD_TYPE, WORLD_SEED);
+    });
+
+    Terrain::generate(destination, from, to, WORLD_TYPE, WORLD_SEED, columns);
+}
+
+//==============================================================================
+static void generateRegion(const i32Vec3 region_position, const Options & options, Progress & progress, ColumnCache & column_cache)
+{
+    const std::string file_name = WORLD_ROOT + to_string(region_position);
+
+    if (!options.force && RegionFile::detect(file_name) != RegionFile::Format::MISSING)
+    {
+        ++progress.skipped;
+        return;
+    }
+
+    const auto capacity = std::max(PALETTE_MAX_SIZE, ChunkCodec::bound(CHUNK_CODEC, CHUNK_DATA_SIZE));
+    std::unique_ptr<Block[]> blocks{ std::make_unique<Block[]>(CHUNK_SIZE) };
+    std::unique_ptr<char[]> compressed{ std::make_unique<char[]>(capacity) };
+
+    // one chunk more per axis: meshes at the upper border reach into the next region
+    constexpr i32Vec3 SUMMARY_SIZES{ REGION_SIZE + 1, REGION_SIZE + 1, REGION_SIZE + 1 };
+    std::vector<ChunkSummary> summaries(static_cast<std::size_t>(product(SUMMARY_SIZES)));
+
+    RegionFile file;
+    file.create(file_name, CHUNK_REGION_SIZE, REGION_USER_HEADER_SIZE);
+
+    const auto first_chunk = region_position * REGION_SIZES;
+    i32Vec3 offset;
+
+    for (offset[2] = 0; offset[2] < SUMMARY_SIZES[2]; ++offset[2])
+        for (offset[1] = 0; offset[1] < SUMMARY_SIZES[1]; ++offset[1])
+            for (offset[0] = 0; offset[0] < SUMMARY_SIZES[0]; ++offset[0])
+            {
+                const bool inside = all(offset < REGION_SIZES);
+
+                // the border layer is only needed for mesh statuses
+                if (!inside && !options.meshes)
+                    continue;
+
+                const auto chunk_position = first_chunk + offset;
+                generateChunk(blocks.get(), chunk_position, column_cache);
+
+                const auto summary = ChunkSummary::of(blocks.get(), CHUNK_SIZES);
+                summaries[position_to_index(offset, SUMMARY_SIZES)] = summary;
+
+                if (!inside)
+                    continue;
+
+                const auto * source = reinterpret_cast<const char *>(blocks.get());
+
+                auto codec = Codec::PALETTE;
+                auto size = ChunkCodec::compress(Codec::PALETTE, compressed.get(), PALETTE_MAX_SIZE, source, CHUNK_DATA_SIZE, CHUNK_SIZES);
+
+                if (size == 0)
+                {
+                    codec = CHUNK_CODEC;
+                    size = ChunkCodec::compress(CHUNK_CODEC, compressed.get(), capacity, source, CHUNK_DATA_SIZE, CHUNK_SIZES);
+                }
+
+                if (size == 0)
+                    throw std::runtime_error("Compressing chunk " + to_string(chunk_position) + " failed.");
+
+                file.stageChunk(position_to_index(offset, REGION_SIZES), compressed.get(), static_cast<int>(size), static_cast<int>(codec));
+
+                ++progress.chunks;
+                progress.bytes += static_cast<long long>(size);
+            }
+
+    // user header: mesh statuses, then chunk summaries, both in position_to_index() order
+    std::vector<char> mesh_statuses(CHUNK_REGION_SIZE, 0);
+    std::vector<ChunkSummary> region_summaries(CHUNK_REGION_SIZE);
+
+    for (offset[2] = 0; offset[2] < REGION_SIZE; ++offset[2])
+        for (offset[1] = 0; offset[1] < REGION_SIZE; ++offset[1])
+            for (offset[0] = 0; offset[0] < REGION_SIZE; ++offset[0])
+            {
+                region_summaries[position_to_index(offset, REGION_SIZES)] = summaries[position_to_index(offset, SUMMARY_SIZES)];
+
+                if (!options.meshes)
+                    continue;
+
+                // a mesh covers the 2x2x2 chunks starting at its own position (see World::meshProvenEmpty)
+                bool all_empty = true, all_solid = true;
+                i32Vec3 corner;
+
+                for (corner[2] = 0; corner[2] < 2; ++corner[2])
+                    for (corner[1] = 0; corner[1] < 2; ++corner[1])
+                        for (corner[0] = 0; corner[0] < 2; ++corner[0])
+                        {
+                            const auto summary = summaries[position_to_index(offset + corner, SUMMARY_SIZES)];
+                            all_empty = all_empty && summary.allEmpty();
+                            all_solid = all_solid && summary.allSolid();
+                        }
+
+                if (all_empty || all_solid)
+                    mesh_statuses[position_to_index(offset, REGION_SIZES)] = MESH_EMPTY;
+            }
+
+    file.writeUserHeader(mesh_statuses.data(), 0, mesh_statuses.size());
+    file.writeUserHeader(region_summaries.data(), REGION_SUMMARIES_OFFSET, sizeof(ChunkSummary) * region_summaries.size());
+    file.commit();
+    file.close();
+
+    ++progress.regions;
+}
+
+//==============================================================================
+int main(int argc, char * argv[])
+{
+    Options options{ {}, {}, static_cast<int>(std::max(1u, std::thread::hardware_concurrency())), false, false };
+    std::vector<int> numbers;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--meshes") == 0)
+            options.meshes = true;
+        else if (std::strcmp(argv[i], "--force") == 0)
+            options.force = true;
+        else
+            numbers.push_back(std::atoi(argv[i]));
+    }
+
+    if (numbers.size() != 6 && numbers.size() != 7)
+    {
+        std::cout << "Usage: " << argv[0] << " from_x from_y from_z to_x to_y to_z [threads] [--meshes] [--force]\n";
+        return 1;
+    }
+
+    options.from = { numbers[0], numbers[1], numbers[2] };
+    options.to = { numbers[3], numbers[4], numbers[5] };
+
+    if (numbers.size() == 7)
+        options.threads = std::max(1, numbers[6]);
+
+    if (!all(options.from <= options.to))
+    {
+        std::cout << "The first corner must not be bigger than the second one.\n";
+        return 1;
+    }
+
+    ::mkdir(WORLD_ROOT, 0755);
+
+    const auto counts = options.to - options.from + 1;
+    const int region_count = product(counts);
+
+    std::cout << "Generating " << region_count << " regions with " << options.threads << " threads, codec "
+              << ChunkCodec::name(CHUNK_CODEC) << (options.meshes ? ", with mesh statuses" : "") << '\n';
+
+    Progress progress;
+    ColumnCache column_cache{ COLUMN_CACHE_PER_THREAD * options.threads };
+    std::atomic<int> next{ 0 };
+    std::atomic<bool> failed{ false };
+    std::mutex error_lock;
+    std::string error;
+
+    const auto begin = Clock::now();
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < options.threads; ++t)
+        threads.emplace_back([&]
+        {
+            for (auto index = next.fetch_add(1); index < region_count && !failed; index = next.fetch_add(1))
+            {
+                i32Vec3 position;
+                position[0] = options.from[0] + index % counts[0];
+                position[1] = options.from[1] + index / counts[0] % counts[1];
+                position[2] = options.from[2] + index / (counts[0] * counts[1]);
+
+                try
+                {
+                    generateRegion(position, options, progress, column_cache);
+                }
+                catch (const std::exception & exception)
+                {
+                    std::unique_lock<std::mutex> lock{ error_lock };
+                    error = exception.what();
+                    failed = true;
+                }
+            }
+        });
+
+    const auto report = [&]
+    {
+        const auto seconds = std::chrono::duration<double>{ Clock::now() - begin }.count();
+        const auto chunks = progress.chunks.load();
+
+        std::cout << std::fixed << std::setprecision(1)
+                  << "\r" << progress.regions.load() + progress.skipped.load() << "/" << region_count << " regions ("
+                  << progress.skipped.load() << " skipped), " << chunks << " chunks, "
+                  << chunks / std::max(seconds, 1e-3) << " chunks/s, "
+                  << progress.bytes.load() / (1024.0 * 1024.0) << " MiB written, " << seconds << " s" << std::flush;
+    };
+
+    while (progress.regions.load() + progress.skipped.load() < region_count && !failed)
+    {
+        report();
+        std::this_thread::sleep_for(std::chrono::seconds{ 1 });
+    }
+
+    for (auto & thread : threads)
+        thread.join();
+
+    report();
+    std::cout << '\n';
+
+    if (Terrain::hasColumns(WORLD_TYPE))
+        std::cout << "Column cache hits: " << column_cache.hits() << ", misses: " << column_cache.misses() << '\n';
+
+    if (TerrainPipeline::chunks() > 0)
+        for (int i = 0; i < static_cast<int>(TerrainPipeline::Stage::last); ++i)
+        {
+            const auto stage = static_cast<TerrainPipeline::Stage>(i);
+            std::cout << "  " << TerrainPipeline::name(stage) << ": " << TerrainPipeline::seconds(stage) * 1e6 / static_cast<double>(TerrainPipeline::chunks()) << " us per chunk\n";
+        }
+
+    if (failed)
+    {
+        std::cout << "Failed: " << error << '\n';
+        return 1;
+    }
+
+    return 0;
+}